@@ -0,0 +1,248 @@
+/**
+ * EventQueue micro-benchmarks
+ *
+ * Runs headless (SDL is only used for sizeof(SDL_Event)), every scenario uses
+ * a fresh EventQueue. Reported per scenario:
+ * - events/s: handled events per second of wall time, pushing included
+ * - p50/p99: latency from push_event() to the handler call, including the
+ *   wait behind the other events in flight (see in_flight_limit)
+ * - allocs/event: global operator new calls during the run per handled event
+ *
+ * usage: minekraf_bench_eventqueue [events per scenario]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <latch>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SDL3/SDL_events.h"
+#include "spdlog/sinks/null_sink.h"
+
+#include "core/eventqueue.h"
+#include "core/logger/logger.h"
+
+using namespace tedlhy::minekraf;
+
+using Clock = std::chrono::steady_clock;
+
+static std::atomic<size_t> allocations{0};
+
+void* operator new(size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (auto block = std::malloc(size ? size : 1)) {
+    return block;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* block) noexcept
+{
+  std::free(block);
+}
+
+void operator delete(void* block, size_t) noexcept
+{
+  std::free(block);
+}
+
+struct Scenario {
+  const char* name;
+  size_t producers = 1;
+  size_t categories = 1;
+  size_t payload_size = 0;
+  bool repush = false;  // handlers push a follow-up event, latency is measured at the follow-up
+};
+
+/// category data shared by the handlers of one run
+struct RunState {
+  EventQueue* eventqueue = nullptr;
+  size_t payload_size = 0;
+  EventID repush_id = 0;  // 0: handlers don't re-push
+  std::vector<Clock::time_point> pushed;  // by sequence number
+  std::vector<Clock::duration> latency;  // by sequence number
+  std::atomic<size_t> handled{0};
+};
+
+static constexpr EventID bench_event_base = 0x10000;
+
+/// producers keep at most this many events in flight, so re-pushing handlers
+/// never find the queue full (they would drop events, see EventQueueOverflowPolicy)
+static constexpr size_t in_flight_limit = 4096;
+
+/// payloads carry the sequence number in their first bytes, empty ones in the data pointer
+static uint64_t _sequence(void* data, size_t payload_size)
+{
+  if (payload_size < sizeof(uint64_t)) {
+    return reinterpret_cast<uintptr_t>(data);
+  }
+  uint64_t sequence;
+  std::memcpy(&sequence, data, sizeof(sequence));
+  return sequence;
+}
+
+static int _measure_handler(EventID, void* data, void* categorydata)
+{
+  auto& state = *static_cast<RunState*>(categorydata);
+  auto sequence = _sequence(data, state.payload_size);
+  state.latency[sequence] = Clock::now() - state.pushed[sequence];
+  state.handled.fetch_add(1, std::memory_order_relaxed);
+  return 0;
+}
+
+static int _repush_handler(EventID, void* data, void* categorydata)
+{
+  auto& state = *static_cast<RunState*>(categorydata);
+  state.eventqueue->push_event(state.repush_id, data, state.payload_size);
+  return 0;
+}
+
+static void _push(RunState& state, EventID id, uint64_t sequence, std::vector<std::byte>& payload)
+{
+  state.pushed[sequence] = Clock::now();
+  if (state.payload_size < sizeof(uint64_t)) {
+    // too small to carry the sequence number, pass it as external data
+    state.eventqueue->push_event(id, reinterpret_cast<void*>(static_cast<uintptr_t>(sequence)), 0);
+    return;
+  }
+  std::memcpy(payload.data(), &sequence, sizeof(sequence));
+  state.eventqueue->push_event(id, payload.data(), state.payload_size);
+}
+
+static void run(const Scenario& scenario, size_t events)
+{
+  EventQueue eventqueue(EventQueueInitParams{
+    .capacity = 1 << 16,
+    .policy = EventQueueOverflowPolicy::block,
+  });
+
+  RunState state;
+  state.eventqueue = &eventqueue;
+  state.payload_size = scenario.payload_size;
+  state.pushed.resize(events);
+  state.latency.resize(events);
+
+  for (size_t i = 0; i < scenario.categories; i++) {
+    EventCategory category{
+      .id = static_cast<EventCategoryID>(i + 1),
+      .name = "bench" + std::to_string(i),
+      .event_ids = {bench_event_base + i},
+      .handlers = {scenario.repush ? _repush_handler : _measure_handler},
+    };
+    eventqueue.insert_category(std::move(category), &state, 0);
+  }
+  if (scenario.repush) {
+    state.repush_id = bench_event_base + scenario.categories;
+    EventCategory category{
+      .id = static_cast<EventCategoryID>(scenario.categories + 1),
+      .name = "bench_repush",
+      .event_ids = {state.repush_id},
+      .handlers = {_measure_handler},
+    };
+    eventqueue.insert_category(std::move(category), &state, 0);
+  }
+
+  // warm up the slabs and lanes so the steady state is measured
+  {
+    std::vector<std::byte> payload(std::max<size_t>(scenario.payload_size, 1));
+    auto warmup = std::min(events, in_flight_limit);
+    for (size_t i = 0; i < warmup; i++) {
+      _push(state, bench_event_base + i % scenario.categories, i, payload);
+    }
+    while (state.handled.load(std::memory_order_relaxed) < warmup) {
+      eventqueue.tick();
+    }
+    state.handled.store(0, std::memory_order_relaxed);
+  }
+
+  std::latch start(static_cast<std::ptrdiff_t>(scenario.producers) + 1);
+  std::vector<std::thread> producers;
+  for (size_t p = 0; p < scenario.producers; p++) {
+    producers.emplace_back([&, p] {
+      std::vector<std::byte> payload(std::max<size_t>(scenario.payload_size, 1));
+      start.arrive_and_wait();
+      for (size_t i = p; i < events; i += scenario.producers) {
+        while (i >= state.handled.load(std::memory_order_relaxed) + in_flight_limit) {
+          std::this_thread::yield();
+        }
+        _push(state, bench_event_base + i % scenario.categories, i, payload);
+      }
+    });
+  }
+
+  auto allocations_before = allocations.load(std::memory_order_relaxed);
+  start.arrive_and_wait();
+  auto begin = Clock::now();
+
+  while (state.handled.load(std::memory_order_relaxed) < events) {
+    eventqueue.tick();
+  }
+
+  auto elapsed = Clock::now() - begin;
+  auto allocations_after = allocations.load(std::memory_order_relaxed);
+
+  for (auto& producer : producers) {
+    producer.join();
+  }
+
+  std::sort(state.latency.begin(), state.latency.end());
+  auto percentile = [&](double p) {
+    auto index = std::min(state.latency.size() - 1, static_cast<size_t>(p * state.latency.size()));
+    return std::chrono::duration<double, std::micro>(state.latency[index]).count();
+  };
+
+  auto seconds = std::chrono::duration<double>(elapsed).count();
+  std::printf("%-32s %10zu %14.0f %10.2f %10.2f %14.3f\n", scenario.name, events, events / seconds,
+    percentile(0.50), percentile(0.99), static_cast<double>(allocations_after - allocations_before) / events);
+}
+
+int main(int argc, char* argv[])
+{
+  size_t events = 1'000'000;
+  if (argc > 1) {
+    events = std::strtoull(argv[1], nullptr, 10);
+  }
+  if (!events) {
+    std::fprintf(stderr, "usage: %s [events per scenario]\n", argv[0]);
+    return 1;
+  }
+
+  // keep the logger quiet, formatting is not what is being measured
+  auto logger = std::make_shared<logger::Logger>(
+    logger::LoggerInitParams{.defaultlevel = logger::LogLevel::warning},
+    std::initializer_list<logger::CategoryValT>{},
+    std::initializer_list<std::shared_ptr<spdlog::sinks::sink>>{std::make_shared<spdlog::sinks::null_sink_mt>()});
+  logger::set(logger);
+
+  const Scenario scenarios[] = {
+    {.name = "1 producer, 0 B"},
+    {.name = "1 producer, 16 B", .payload_size = 16},
+    {.name = "1 producer, SDL_Event", .payload_size = sizeof(SDL_Event)},
+    {.name = "1 producer, 1 KiB", .payload_size = 1024},
+    {.name = "1 producer, 128 KiB", .payload_size = 128 * 1024},
+    {.name = "4 producers, 0 B", .producers = 4},
+    {.name = "4 producers, SDL_Event", .producers = 4, .payload_size = sizeof(SDL_Event)},
+    {.name = "1 producer, 100 categories", .categories = 100},
+    {.name = "4 producers, 100 categories", .producers = 4, .categories = 100},
+    {.name = "1 producer, re-push, SDL_Event", .payload_size = sizeof(SDL_Event), .repush = true},
+  };
+
+  std::printf("%-32s %10s %14s %10s %10s %14s\n", "scenario", "events", "events/s", "p50 us", "p99 us",
+    "allocs/event");
+  for (const auto& scenario : scenarios) {
+    // the 128 KiB payloads go to the heap, keep that run short
+    run(scenario, scenario.payload_size > 64 * 1024 ? std::max<size_t>(events / 100, 1) : events);
+  }
+
+  return 0;
+}
@@ -0,0 +1,265 @@
+/**
+ * Logger micro-benchmarks
+ *
+ * Runs headless, every scenario uses a fresh Logger (with its own thread
+ * pool) and logs one message with three arguments per call. Reported per
+ * scenario:
+ * - ns/call: wall time of a calling thread per call (averaged over the
+ *   threads), sustained: once the queue is full this is the rate the workers
+ *   drain it at
+ * - p50/p99: duration of a single call, timed in a second pass (the clock
+ *   reads add a few tens of ns, which dominates the filtered scenarios)
+ * - MB/s: formatted bytes reaching the measured sink per second, until the
+ *   queue has been drained
+ *
+ * Messages below ACTIVE_LEVEL are compiled out, build with
+ * -DMINEKRAF_LOG_ACTIVE_LEVEL=debug to see the "trace" scenarios vanish.
+ *
+ * usage: minekraf_bench_logger [calls per thread]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spdlog/sinks/base_sink.h"
+#include "spdlog/sinks/basic_file_sink.h"
+
+#include "core/logger/flightrecordersink.h"
+#include "core/logger/logger.h"
+#include "core/logger/ringbuffersink.h"
+
+using namespace tedlhy::minekraf;
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr const char* bench_log_path = "bench_logger.txt";
+static constexpr const char* bench_flight_path = "bench_logger.flight";
+
+static constexpr logger::CategoryKeyT bench_category = 1;
+
+/// Formats like a file sink would but only counts the bytes, to measure logging without disk I/O
+class CountingSink final : public spdlog::sinks::base_sink<std::mutex> {
+  std::atomic<uint64_t> _bytes{0};
+
+protected:
+  void sink_it_(const spdlog::details::log_msg& msg) override
+  {
+    spdlog::memory_buf_t formatted;
+    formatter_->format(msg, formatted);
+    _bytes.fetch_add(formatted.size(), std::memory_order_relaxed);
+  }
+
+  void flush_() override
+  {
+  }
+
+public:
+  uint64_t bytes() const
+  {
+    return _bytes.load(std::memory_order_relaxed);
+  }
+};
+
+enum class Sinks {
+  counting,  // CountingSink
+  file,  // basic_file_sink_mt
+  all,  // basic_file_sink_mt, RingBufferSink and FlightRecorderSink, the app's setup
+};
+
+struct Scenario {
+  const char* name;
+  size_t threads = 1;
+  logger::LogLevel::LogLevelEnum defaultlevel = logger::LogLevel::trace;
+  logger::LogLevel::LogLevelEnum categorylevel = logger::LogLevel::trace;
+  logger::LogLevel::LogLevelEnum level = logger::LogLevel::info;  // of the messages, info or trace
+  Sinks sinks = Sinks::counting;
+  logger::DeferredMode deferred = logger::DeferredMode::off;
+};
+
+struct Run {
+  std::shared_ptr<logger::Logger> logger;
+  std::shared_ptr<CountingSink> counting;  // Sinks::counting only
+};
+
+static Run _make_logger(const Scenario& scenario)
+{
+  logger::LoggerInitParams params{
+    .defaultlevel = scenario.defaultlevel,
+    .deferred = scenario.deferred,
+  };
+  std::initializer_list<logger::CategoryValT> categories = {
+    {bench_category, {"bench", scenario.categorylevel}},
+  };
+
+  Run run;
+  switch (scenario.sinks) {
+    case Sinks::counting:
+      run.counting = std::make_shared<CountingSink>();
+      run.logger = std::make_shared<logger::Logger>(std::move(params), categories,
+        std::initializer_list<std::shared_ptr<spdlog::sinks::sink>>{run.counting});
+      break;
+    case Sinks::file:
+      run.logger = std::make_shared<logger::Logger>(std::move(params), categories,
+        std::initializer_list<std::shared_ptr<spdlog::sinks::sink>>{
+          std::make_shared<spdlog::sinks::basic_file_sink_mt>(bench_log_path, true)});
+      break;
+    case Sinks::all:
+      run.logger = std::make_shared<logger::Logger>(std::move(params), categories,
+        std::initializer_list<std::shared_ptr<spdlog::sinks::sink>>{
+          std::make_shared<spdlog::sinks::basic_file_sink_mt>(bench_log_path, true),
+          std::make_shared<logger::RingBufferSink>(16384, 512),
+          std::make_shared<logger::FlightRecorderSink>(bench_flight_path, 16 << 20)});
+      break;
+  }
+  return run;
+}
+
+template<logger::LogLevel::LogLevelEnum Level>
+static void _call(logger::Logger& logger, uint64_t i)
+{
+  logger.log<Level>(bench_category, "bench message {} with a float {:.3f} and a {}", i, i * 0.5, "string");
+}
+
+static void _call(logger::Logger& logger, logger::LogLevel::LogLevelEnum level, uint64_t i)
+{
+  if (level == logger::LogLevel::trace) {
+    _call<logger::LogLevel::trace>(logger, i);
+  } else {
+    _call<logger::LogLevel::info>(logger, i);
+  }
+}
+
+/// run `body(thread index)` on `threads` threads started together, returns their mean wall time
+template<typename Fn>
+static Clock::duration _run_threads(size_t threads, Fn&& body)
+{
+  // every thread times itself, the main thread may only get to run once they are done
+  std::vector<Clock::duration> elapsed(threads);
+  std::latch start(static_cast<std::ptrdiff_t>(threads));
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      start.arrive_and_wait();
+      auto begin = Clock::now();
+      body(t);
+      elapsed[t] = Clock::now() - begin;
+    });
+  }
+
+  Clock::duration total{0};
+  for (size_t t = 0; t < threads; t++) {
+    workers[t].join();
+    total += elapsed[t];
+  }
+  return total / threads;
+}
+
+static void run(const Scenario& scenario, size_t calls)
+{
+  // throughput: untimed calls, then drain the queue (destroying the Logger joins its workers)
+  double ns_per_call;
+  double bytes_per_second;
+  {
+    auto run = _make_logger(scenario);
+    auto begin = Clock::now();
+    auto elapsed = _run_threads(scenario.threads, [&](size_t t) {
+      for (uint64_t i = 0; i < calls; i++) {
+        _call(*run.logger, scenario.level, t * calls + i);
+      }
+    });
+    run.logger->flush();
+    run.logger.reset();
+    auto drained = Clock::now() - begin;
+
+    uint64_t bytes = run.counting ? run.counting->bytes() : std::filesystem::file_size(bench_log_path);
+    ns_per_call = std::chrono::duration<double, std::nano>(elapsed).count() / calls;
+    bytes_per_second = bytes / std::chrono::duration<double>(drained).count();
+  }
+
+  // latency: every call timed on its own
+  std::vector<std::vector<Clock::duration>> latency(scenario.threads);
+  {
+    auto run = _make_logger(scenario);
+    auto timed_calls = std::min<size_t>(calls, 200'000);
+    _run_threads(scenario.threads, [&](size_t t) {
+      auto& durations = latency[t];
+      durations.reserve(timed_calls);
+      for (uint64_t i = 0; i < timed_calls; i++) {
+        auto start = Clock::now();
+        _call(*run.logger, scenario.level, t * timed_calls + i);
+        durations.push_back(Clock::now() - start);
+      }
+    });
+  }
+
+  std::vector<Clock::duration> durations;
+  for (auto& thread_durations : latency) {
+    durations.insert(durations.end(), thread_durations.begin(), thread_durations.end());
+  }
+  std::sort(durations.begin(), durations.end());
+  auto percentile = [&](double p) {
+    auto index = std::min(durations.size() - 1, static_cast<size_t>(p * durations.size()));
+    return std::chrono::duration<double, std::nano>(durations[index]).count();
+  };
+
+  std::printf("%-40s %8zu %12.1f %10.0f %10.0f %10.1f\n", scenario.name, scenario.threads, ns_per_call,
+    percentile(0.50), percentile(0.99), bytes_per_second / (1024 * 1024));
+}
+
+int main(int argc, char* argv[])
+{
+  size_t calls = 200'000;
+  if (argc > 1) {
+    calls = std::strtoull(argv[1], nullptr, 10);
+  }
+  if (!calls) {
+    std::fprintf(stderr, "usage: %s [calls per thread]\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<Scenario> scenarios = {
+    {.name = "filtered, global level", .defaultlevel = logger::LogLevel::warning},
+    {.name = "filtered, category level", .categorylevel = logger::LogLevel::warning},
+    {.name = "trace, disabled", .defaultlevel = logger::LogLevel::info, .level = logger::LogLevel::trace},
+    {.name = "trace, enabled", .level = logger::LogLevel::trace},
+    {.name = "enabled, counting sink"},
+    {.name = "enabled, counting sink, deferred", .deferred = logger::DeferredMode::format},
+    {.name = "enabled, async file sink", .sinks = Sinks::file},
+    {.name = "enabled, async file sink, deferred", .sinks = Sinks::file, .deferred = logger::DeferredMode::format},
+    {.name = "enabled, file + ring + flight sinks", .sinks = Sinks::all},
+    {.name = "trace, enabled, file + ring + flight", .level = logger::LogLevel::trace, .sinks = Sinks::all},
+  };
+
+  // the same with more callers, up to the number of cores
+  auto max_threads = std::clamp<size_t>(std::thread::hardware_concurrency(), 2, 16);
+  for (size_t threads = 2; threads <= max_threads; threads *= 2) {
+    scenarios.push_back({.name = "filtered, global level", .threads = threads,
+      .defaultlevel = logger::LogLevel::warning});
+    scenarios.push_back({.name = "enabled, async file sink", .threads = threads, .sinks = Sinks::file});
+    scenarios.push_back({.name = "enabled, async file sink, deferred", .threads = threads, .sinks = Sinks::file,
+      .deferred = logger::DeferredMode::format});
+  }
+
+  std::printf("active level: %s\n", std::string(logger::LogLevel(logger::ACTIVE_LEVEL)).c_str());
+  std::printf("%-40s %8s %12s %10s %10s %10s\n", "scenario", "threads", "ns/call", "p50 ns", "p99 ns", "MB/s");
+  for (const auto& scenario : scenarios) {
+    run(scenario, calls);
+  }
+
+  std::error_code error;
+  std::filesystem::remove(bench_log_path, error);
+  std::filesystem::remove(bench_flight_path, error);
+  std::filesystem::remove(std::string(bench_flight_path) + ".prev", error);
+  return 0;
+}
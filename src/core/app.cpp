@@ -7,17 +7,54 @@
 #include "SDL3/SDL_log.h"
 #include "SDL3/SDL_opengl.h"
 
+#include "imgui.h"
 #include "imgui_impl_sdl3.h"
 
 #include "version.h"
 
 using namespace tedlhy::minekraf;
 
+namespace tedlhy::minekraf {
+
+// SDL events are pushed by their SDL event type (see callback_SDL_Event)
+template<>
+struct EventTraits<SDL_QuitEvent> {
+  static EventID id()
+  {
+    return SDL_EVENT_QUIT;
+  }
+};
+
+template<>
+struct EventTraits<SDL_KeyboardEvent> {
+  static EventID id()
+  {
+    return SDL_EVENT_KEY_DOWN;
+  }
+};
+
+}  // namespace tedlhy::minekraf
+
 struct SDL_EventFilterCtx {
   SDL_EventFilter filter = nullptr;
   void* userdata = nullptr;
 } static _sdl_original_eventfilter;
 
+// leave most of the frame to simulation and rendering, events which do not
+// fit are handled in the next frame
+static constexpr std::chrono::microseconds eventqueue_tick_budget{4000};
+
+// the world advances in steps of this length, independent of the frame rate
+static constexpr std::chrono::duration<double> simulation_step{1.0 / 60};
+
+// steps a single frame may run before the rest of the frame time is dropped,
+// otherwise a slow frame makes the next one slower (spiral of death)
+static constexpr size_t max_simulation_steps = 5;
+
+// a trace session fills this in seconds, only the recent past is viewable in-game
+static constexpr size_t log_console_capacity = 16384;
+static constexpr size_t log_console_max_message_size = 512;
+
 static logger::LogLevel _sdl_log_prio_to_lvl(SDL_LogPriority priority)
 {
   logger::LogLevel level = logger::LogLevel::info;
@@ -49,6 +86,55 @@ static logger::LogLevel _sdl_log_prio_to_lvl(SDL_LogPriority priority)
   return level;
 }
 
+// merge mouse motion of the same mouse and window, keeping the last position
+// and accumulating the relative motion
+static bool _sdl_coalesce_mouse_motion(EventID id, void* queued, const void* incoming)
+{
+  (void)id;
+  auto& motion = static_cast<SDL_Event*>(queued)->motion;
+  const auto& next = static_cast<const SDL_Event*>(incoming)->motion;
+
+  if (motion.which != next.which || motion.windowID != next.windowID) {
+    return false;
+  }
+
+  float xrel = motion.xrel + next.xrel;
+  float yrel = motion.yrel + next.yrel;
+  motion = next;
+  motion.xrel = xrel;
+  motion.yrel = yrel;
+  return true;
+}
+
+// keep only the last size of a window
+static bool _sdl_coalesce_window_size(EventID id, void* queued, const void* incoming)
+{
+  (void)id;
+  auto& window = static_cast<SDL_Event*>(queued)->window;
+  const auto& next = static_cast<const SDL_Event*>(incoming)->window;
+
+  if (window.windowID != next.windowID) {
+    return false;
+  }
+
+  window = next;
+  return true;
+}
+
+// forward an event to ImGui, its IO state belongs to the main thread, so this
+// runs during tick() and never from callback_SDL_Event (which any thread
+// pushing an SDL event may call); text pointers in the event stay valid until
+// the next SDL_PumpEvents(), which preUpdate() calls after tick()
+static int _imgui_process_event(EventID id, void* eventdata, void* categorydata)
+{
+  (void)id;
+  (void)categorydata;
+  if (ImGui::GetCurrentContext()) {
+    ImGui_ImplSDL3_ProcessEvent(static_cast<SDL_Event*>(eventdata));
+  }
+  return 0;
+}
+
 static logger::LogLevel _sdl_log_cat_to_lvl(SDL_LogCategory category)
 {
   return _sdl_log_prio_to_lvl(SDL_GetLogPriority(category));
@@ -57,16 +143,34 @@ static logger::LogLevel _sdl_log_cat_to_lvl(SDL_LogCategory category)
 void App::preUpdate(double deltatime)
 {
   window_mgr->preUpdate(deltatime);
-  eventqueue.tick();
+  if (event_replay && !event_replay->pump(eventqueue, std::chrono::steady_clock::now())) {
+    // everything has been pushed, this tick handles the rest
+    logger->info("App: replayed {} events, exiting", event_replay->count());
+    event_replay.reset();
+    exit();
+  }
+  // results of background work first, their follow-up events are handled by this tick
+  eventqueue.drain_completions();
+  eventqueue.tick(eventqueue_tick_budget);
   SDL_PumpEvents();  // force event queue udate for SDL, since we are filtering
 }
 
+void App::simulate(double steptime)
+{
+  (void)steptime;
+  simulation_steps++;
+}
+
 void App::update(double deltatime)
 {
   window_mgr->update(deltatime);
   // clear screen with dark magenta
   glClearColor(0.2, 0.05, 0.2, 1);
   glClear(GL_COLOR_BUFFER_BIT);
+
+  if (show_log_console) {
+    log_console->draw("Log", &show_log_console);
+  }
 }
 
 void App::postUpdate(double deltatime)
@@ -74,7 +178,18 @@ void App::postUpdate(double deltatime)
   window_mgr->postUpdate(deltatime);
 }
 
-App::App() : running(false), window_mgr(), logger(), eventqueue(EventQueue::get())
+App::App() :
+  running(false),
+  window_mgr(),
+  logger(),
+  log_sink(),
+  log_console(),
+  show_log_console(false),
+  eventqueue(EventQueue::get()),
+  event_replay(),
+  simulation_alpha(0),
+  simulation_steps(0),
+  skipped_steps(0)
 {
   std::atexit(SDL_Quit);  // register SDL_Quit on application exit
 
@@ -85,6 +200,8 @@ App::App() : running(false), window_mgr(), logger(), eventqueue(EventQueue::get(
   logger = std::make_shared<logger::Logger>(logger::LoggerInitParams{
     .defaultlevel = logger::LogLevel::trace,
     .filepath = "log.txt",
+    .deferred = logger::DeferredMode::format,
+    .flightrecorder_size = 16 << 20,
   });
   logger::set(logger);
 
@@ -97,69 +214,81 @@ App::App() : running(false), window_mgr(), logger(), eventqueue(EventQueue::get(
 
   // Init event queue
 
-  auto sdl_app_exit_handler = [](EventID id, void* data, void* categorydata) -> int {
-    App* app = static_cast<App*>(categorydata);
-    SDL_Event* eventdata = static_cast<SDL_Event*>(data);
-
-    auto logger = logger::get();
-    logger->trace("sdl_app_exit_handler(): {{ event: {:#x}, &app: {:p}, &event->type: {:#x} }}", id, (void*)app,
-      eventdata->type);
-
-    if (!app) {
-      // something went horribly wrong
-      logger->critical("Failure to cast App data!");
-      throw std::runtime_error("Failure to cast App data");
-    }
-
-    if (!eventdata) {
-      // something went horribly wrong
-      logger->critical("Failure to cast SDL_Event data!");
-      throw std::runtime_error("Failure to cast SDL_Event data");
+  eventqueue.subscribe<SDL_QuitEvent>([this](SDL_QuitEvent& event) {
+    logger->trace("App: exit event {:#x}", static_cast<EventID>(event.type));
+    exit();
+  });
+  eventqueue.subscribe<SDL_KeyboardEvent>([this](SDL_KeyboardEvent& event) {
+    // F1 typed into an ImGui text field stays there
+    if (event.key == SDLK_F1 && !event.repeat && !ImGui::GetIO().WantCaptureKeyboard) {
+      show_log_console = !show_log_console;
     }
+  });
+  if (auto channel = eventqueue.channel<SDL_QuitEvent>()) {
+    // SDL_EVENT_TERMINATING only carries the common event header, which
+    // SDL_QuitEvent consists of as well
+    eventqueue.append_category_event(*channel, SDL_EVENT_TERMINATING);
+    eventqueue.set_category_priority(*channel, EventPriority::window);
+  }
 
-    switch (id) {
-      case SDL_EVENT_QUIT:
-      case SDL_EVENT_TERMINATING:
-        break;
-      default:
-        logger->critical("{} is not a valid exit event id", id);
-        throw std::runtime_error("exit event handler called with invalid id");
-    }
-    app->exit();
-    return 0;
-  };
+  // high frequency SDL events, handlers see at most one of them per tick
+  eventqueue.insert_category(EventCategory{
+    .id = eventqueue.find_next_free_category(0),
+    .name = "SDL_MouseMotion",
+    .event_ids = {SDL_EVENT_MOUSE_MOTION},
+    .handlers = {_imgui_process_event},
+    .priority = EventPriority::input,
+    .coalesce = _sdl_coalesce_mouse_motion,
+  });
+  eventqueue.insert_category(EventCategory{
+    .id = eventqueue.find_next_free_category(0),
+    .name = "SDL_WindowSize",
+    .event_ids = {SDL_EVENT_WINDOW_RESIZED, SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED},
+    .handlers = {},
+    .priority = EventPriority::window,
+    .coalesce = _sdl_coalesce_window_size,
+  });
 
-  EventCategoryID id = eventqueue.find_next_free_category(0);
-  eventqueue.insert_category(
-    EventCategory{
-      .id = id,
-      .name = "SDL_ApplicationExit",
-      .event_ids = {SDL_EVENT_QUIT, SDL_EVENT_TERMINATING},
-      .handlers = {sdl_app_exit_handler},
-    },
-    this, 0);
+  // the rest of the events ImGui's SDL backend handles
+  eventqueue.insert_category(EventCategory{
+    .id = eventqueue.find_next_free_category(0),
+    .name = "ImGui",
+    .event_ids = {SDL_EVENT_MOUSE_BUTTON_DOWN, SDL_EVENT_MOUSE_BUTTON_UP, SDL_EVENT_MOUSE_WHEEL,
+      SDL_EVENT_KEY_DOWN, SDL_EVENT_KEY_UP, SDL_EVENT_TEXT_INPUT, SDL_EVENT_WINDOW_MOUSE_ENTER,
+      SDL_EVENT_WINDOW_MOUSE_LEAVE, SDL_EVENT_WINDOW_FOCUS_GAINED, SDL_EVENT_WINDOW_FOCUS_LOST,
+      SDL_EVENT_DISPLAY_ORIENTATION, SDL_EVENT_DISPLAY_ADDED, SDL_EVENT_DISPLAY_REMOVED, SDL_EVENT_DISPLAY_MOVED,
+      SDL_EVENT_DISPLAY_CONTENT_SCALE_CHANGED, SDL_EVENT_GAMEPAD_ADDED, SDL_EVENT_GAMEPAD_REMOVED},
+    .handlers = {_imgui_process_event},
+    .priority = EventPriority::input,
+  });
 
   // add EventQueue callback (SDL_EventFilter)
   auto callback_SDL_Event = [](void* userdata, SDL_Event* event) {
-    EventQueue* eventqueue = static_cast<EventQueue*>(userdata);
+    App* app = static_cast<App*>(userdata);
 
-    auto logger = logger::get();
+    auto logger = logger::current();
 
-    if (!eventqueue) {
+    if (!app) {
       // something went horribly wrong
-      logger->critical("Failure to cast EventQueue data!");
-      throw std::runtime_error("Failure to cast EventQueue data");
+      logger->critical("Failure to cast App data!");
+      throw std::runtime_error("Failure to cast App data");
+    }
+
+    if (app->event_replay && event->type != SDL_EVENT_QUIT && event->type != SDL_EVENT_TERMINATING) {
+      // the recording is the input now, only let the user close the app
+      return false;
     }
 
-    // copy event and store in event queue
-    logger->trace("callback_SDL_Event(): pushing event {:#x}", event->type);
-    eventqueue->push_event(event->type, &event, sizeof(SDL_Event));
+    // copy event and store in event queue, mouse motion alone would flood the log
+    static logger::RateLimiter trace_limiter({.burst = 20, .period = std::chrono::seconds(1)});
+    MINEKRAF_LOG_LIMITED(logger, trace_limiter, trace, "callback_SDL_Event(): pushing event {:#x}", event->type);
+    app->eventqueue.push_event(event->type, event, sizeof(SDL_Event));
     return event->type == SDL_EVENT_QUIT;
   };
 
   // save original event filter and set ours
   SDL_GetEventFilter(&_sdl_original_eventfilter.filter, &_sdl_original_eventfilter.userdata);
-  SDL_SetEventFilter(callback_SDL_Event, &eventqueue);
+  SDL_SetEventFilter(callback_SDL_Event, this);
 
   // Init SDL Logger
 
@@ -198,7 +327,8 @@ App::App() : running(false), window_mgr(), logger(), eventqueue(EventQueue::get(
 
   SDL_SetLogOutputFunction(logger_LogOutputFunction, logger.get());
 
-  // TODO: Add ImGui logger sink
+  log_sink = std::make_shared<logger::RingBufferSink>(log_console_capacity, log_console_max_message_size);
+  logger->add_sink(log_sink);
 
   logger->info("Yippie!");
 
@@ -210,6 +340,7 @@ App::App() : running(false), window_mgr(), logger(), eventqueue(EventQueue::get(
   window_mgr = std::make_unique<WindowManager>(params);
 
   // TODO: Add gui manager
+  log_console = std::make_unique<LogConsole>(log_sink);
 
   window_mgr->show();
 }
@@ -228,6 +359,11 @@ App::~App()
   // reset event filter to original
   SDL_SetEventFilter(_sdl_original_eventfilter.filter, _sdl_original_eventfilter.userdata);
 
+  // flush the recording while the logger is still around
+  eventqueue.stop_recording();
+  eventqueue.log_stats();
+  logger->log_stats();
+
   // reset log function
   SDL_SetLogOutputFunction(SDL_GetDefaultLogOutputFunction(), nullptr);
 }
@@ -249,9 +385,29 @@ void App::run()
   running = true;
 
   auto last_time_point = steady_clock::now();
-  duration<double> time_delta{milliseconds{16}};
+  duration<double> time_delta{simulation_step};
+  duration<double> accumulator{0};
+  // a machine too slow for the rate drops steps every frame
+  logger::RateLimiter skip_limiter({.burst = 1, .period = seconds(1)});
   while (running) {
     preUpdate(time_delta.count());
+
+    accumulator += time_delta;
+    size_t steps = 0;
+    for (; accumulator >= simulation_step && steps < max_simulation_steps; steps++) {
+      simulate(simulation_step.count());
+      accumulator -= simulation_step;
+    }
+    if (accumulator >= simulation_step) {
+      // too far behind, keep the fraction of a step so the interpolation stays smooth
+      auto behind = static_cast<uint64_t>(accumulator / simulation_step);
+      skipped_steps += behind;
+      accumulator -= behind * simulation_step;
+      MINEKRAF_LOG_LIMITED(logger, skip_limiter, debug, "App::run(): frame took {:.1f}ms, dropped {} simulation steps",
+        duration<double, std::milli>(time_delta).count(), behind);
+    }
+    simulation_alpha = accumulator / simulation_step;
+
     update(time_delta.count());
     postUpdate(time_delta.count());
 
@@ -259,9 +415,37 @@ void App::run()
     time_delta = duration<double>{time_point - last_time_point};
     std::swap(time_point, last_time_point);
   }
+
+  logger->info("App: ran {} simulation steps at {:.0f}Hz, dropped {} after slow frames", simulation_steps,
+    1 / simulation_step.count(), skipped_steps);
 }
 
 void App::exit()
 {
   running = false;
 }
+
+double App::interpolation() const
+{
+  return simulation_alpha;
+}
+
+bool App::record(const std::string& path)
+{
+  // these SDL events point to strings (or user data) which are gone by the time the recording is replayed
+  return eventqueue.start_recording(path, {SDL_EVENT_TEXT_EDITING, SDL_EVENT_TEXT_EDITING_CANDIDATES,
+    SDL_EVENT_TEXT_INPUT, SDL_EVENT_CLIPBOARD_UPDATE, SDL_EVENT_DROP_FILE, SDL_EVENT_DROP_TEXT, SDL_EVENT_DROP_BEGIN,
+    SDL_EVENT_DROP_COMPLETE, SDL_EVENT_DROP_POSITION, SDL_EVENT_USER});
+}
+
+bool App::replay(const std::string& path, double speed)
+{
+  auto _replay = std::make_unique<EventReplay>();
+  if (!_replay->open(path, speed)) {
+    return false;
+  }
+
+  event_replay = std::move(_replay);
+  window_mgr->hide();
+  return true;
+}
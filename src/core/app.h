@@ -1,10 +1,15 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <string>
 
+#include "gui/logconsole.h"
 #include "logger/logger.h"
+#include "logger/ringbuffersink.h"
 #include "window/windowmanager.h"
 #include "eventqueue.h"
+#include "eventrecorder.h"
 
 namespace tedlhy::minekraf {
 
@@ -13,12 +18,22 @@ class App {
 
   std::unique_ptr<WindowManager> window_mgr;
   std::shared_ptr<logger::Logger> logger;
+  std::shared_ptr<logger::RingBufferSink> log_sink;  // last messages for log_console
+  std::unique_ptr<LogConsole> log_console;
+  bool show_log_console;  // toggled with F1
 
   EventQueue& eventqueue;
+  std::unique_ptr<EventReplay> event_replay;  // set while replaying, live SDL events are ignored then
+
+  double simulation_alpha;  // see interpolation()
+  uint64_t simulation_steps;  // steps run by simulate()
+  uint64_t skipped_steps;  // steps dropped to catch up after slow frames, see run()
 
   App();
 
   void preUpdate(double deltatime);
+  /// advance the world by exactly steptime seconds, called at a fixed rate by run()
+  void simulate(double steptime);
   void update(double deltatime);
   void postUpdate(double deltatime);
 
@@ -26,8 +41,43 @@ public:
   static App& get();
   ~App();
 
+  /**
+   * Run the main loop until exit() is called.
+   *
+   * Events are handled and a frame is rendered once per loop, the simulation
+   * runs at a fixed rate instead (see simulate()): the frame time is
+   * accumulated and as many steps are run as fit in it. Rendering sits
+   * between the last two steps, see interpolation(). A frame runs at most a
+   * few steps, after a stall (or on a machine too slow for the rate) the rest
+   * is dropped and the world slows down instead of falling further behind.
+   */
   void run();
   void exit();
+
+  /**
+   * How far the current frame is past the last simulation step, in steps
+   * ([0, 1)). Rendering interpolates between the previous and the last
+   * simulated state by this.
+   */
+  double interpolation() const;
+
+  /**
+   * Record the events of this session to the file at path. SDL events
+   * holding pointers (text input, drag and drop, clipboard, user events) are
+   * not recorded, see EventQueue::start_recording().
+   *
+   * This method returns false if the recording could not be started.
+   */
+  bool record(const std::string& path);
+
+  /**
+   * Replay a recorded session instead of live input, `speed` scales the
+   * recorded timing (0: as fast as possible). The window is hidden, and the
+   * app exits once the whole recording has been handled.
+   *
+   * This method returns false if the recording could not be opened.
+   */
+  bool replay(const std::string& path, double speed = 1.0);
 };
 
 }  // namespace tedlhy::minekraf
@@ -1,7 +1,11 @@
 #include "eventqueue.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <limits>
+#include <thread>
+#include <utility>
 
 #include "logger/logger.h"
 
@@ -19,19 +23,21 @@ enum EventQueueErrorReason {
   _EventQueueErrorReason_size,
 };
 
+/// trivially copyable, so error events ride inside the event like any small payload
 struct EventQueueError {
-  EventCategory category;
-  EventQueueErrorReason reason;
+  EventCategoryID category = 0;
+  EventQueueErrorReason reason = NoReason;
   EventID queue_id = 0;
   int handler_return = 0;
+  size_t count = 1;  // occurrences in the reporting tick
 };
 
+/// categorydata is the EventQueue, used to look up category names
 int eventqueue_error_handler(EventID id, void* data, void* categorydata)
 {
-  (void)categorydata;
   constexpr const char tag[] = "EventQueueError";
 
-  auto logger = logger::get();
+  auto logger = logger::current();
 
   if (id != EVENTQUEUEERROR_ID) {
     logger->critical("EventQueueError handler called with invalid event id! THIS SHOULD NOT HAPPEN");
@@ -45,22 +51,31 @@ int eventqueue_error_handler(EventID id, void* data, void* categorydata)
     throw std::runtime_error("Failure to cast error event data");
   }
 
-  logger->trace("{}: {{ error {}, Category {} }}", tag, static_cast<int>(error->reason), error->category.name);
+  // only looked up on the (rare) paths which print it
+  auto category_name = [&]() -> std::string {
+    auto eventqueue = static_cast<EventQueue*>(categorydata);
+    auto name = eventqueue ? eventqueue->find_category_name(error->category) : std::nullopt;
+    return name ? *name : "<removed>";
+  };
+
+  logger->trace("{}: {{ error {}, Category id {}, count {} }}", tag, static_cast<int>(error->reason), error->category,
+    error->count);
 
   switch (error->reason) {
     case NoReason:
-      logger->error("{}: Event (id {}) handling general failure", tag, error->queue_id);
+      logger->error("{}: Event (id {}) handling general failure (x{})", tag, error->queue_id, error->count);
       break;
     case EventCategoryNotFound:
-      logger->warning("{}: Event id {} is not registered in a Category", tag, error->queue_id);
+      logger->warning("{}: Event id {} is not registered in a Category (x{})", tag, error->queue_id,
+        error->count);
       break;
     case HandlerReturnError:
-      logger->error("{}: Category {}->handler({}, ...) returned with error code: {}", tag, error->category.name,
-        error->category.id, error->handler_return);
+      logger->error("{}: Category {}->handler({}, ...) returned with error code: {} (x{})", tag, category_name(),
+        error->category, error->handler_return, error->count);
       break;
     case QueueNotEmpty:
       logger->warning("{}: EventQueue is being destructed, but queue still contains Category {} Event id {}", tag,
-        error->category.name, error->queue_id);
+        category_name(), error->queue_id);
       break;
     case QueueNotEmptyNoCategory:
       logger->warning("{}: EventQueue is being destructed, but queue still contains Event id {}", tag, error->queue_id);
@@ -74,6 +89,29 @@ int eventqueue_error_handler(EventID id, void* data, void* categorydata)
   return 0;
 }
 
+/// queue whose handlers the current thread is running, see _enqueue()
+static thread_local const EventQueue* dispatching = nullptr;
+
+/// see EventQueue::instance, 0 is never handed out
+static std::atomic<uint64_t> next_instance{1};
+
+EventID tedlhy::minekraf::_next_typed_event_id()
+{
+  static std::atomic<EventID> next{EVENTQUEUE_TYPED_ID_BASE};
+  return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+EventQueue::Handler EventQueue::Handler::from_func(EventHandlerFunc func)
+{
+  Handler handler;
+  handler.func = func;
+  handler.stats = std::make_shared<HandlerStats>();
+  handler.invoke = [](const Handler& self, EventID id, void* eventdata, void* categorydata) -> int {
+    return self.func(id, eventdata, categorydata);
+  };
+  return handler;
+}
+
 EventQueue& EventQueue::get()
 {
   static EventQueue eventqueue;
@@ -81,164 +119,712 @@ EventQueue& EventQueue::get()
   return eventqueue;
 }
 
-EventQueue::EventQueue() : registry(), queue()
+EventQueue::EventQueue(EventQueueInitParams params) :
+  registry(),
+  queue(params.capacity),
+  lanes(),
+  lanes_registry(),
+  coalesce_pending(),
+  coalesce_touched(),
+  dropped(0),
+  arena(params.arena_slab_size),
+  inline_payloads(0),
+  arena_payloads(0),
+  heap_payloads(0),
+  mutex(),
+  pending_errors(),
+  errors_mutex(),
+  workers(params.worker_count),
+  parallel_jobs(),
+  timers(),
+  timers_mutex(),
+  recorder(),
+  ticks(0),
+  depth(0),
+  max_depth(0),
+  tick_time(),
+  instance(next_instance.fetch_add(1, std::memory_order_relaxed)),
+  mailbox_capacity(params.mailbox_capacity),
+  mailboxes(),
+  mailboxes_mutex(),
+  drain_mailboxes(),
+  policy(params.policy)
 {
   EventCategoryInternal errorcat{
     {
       .id = EVENTQUEUEERROR_CATEGORYID,
       .name = "EventQueueError",
       .event_ids = {EVENTQUEUEERROR_ID},
-      .handlers = {eventqueue_error_handler},
+      .handlers = {},
+      .priority = EventPriority::background,
     },
-    nullptr,
-    false,
+    {Handler::from_func(eventqueue_error_handler)},
+    std::shared_ptr<void>(this, [](void*) {}),
+    std::make_shared<CategoryStats>(),
   };
-  registry.emplace(EVENTQUEUEERROR_CATEGORYID, std::move(errorcat));
+
+  const std::lock_guard lock(mutex);
+
+  auto _registry = std::make_shared<Registry>();
+  _registry->categories.emplace(EVENTQUEUEERROR_CATEGORYID, std::move(errorcat));
+  _publish_nolock(std::move(_registry));
 }
 
 EventQueue::~EventQueue()
 {
-  while (!queue.empty()) {
-    const std::lock_guard lock(mutex);
-
-    auto [id, event] = queue.front();
-    queue.pop();
-
-    auto categoryids = _find_categories_nolock(id);
-    if (categoryids.empty()) {
-      // event id has no category anymore
-      EventQueueError error{
-        .category = {},
-        .reason = QueueNotEmptyNoCategory,
-        .queue_id = id,
-      };
-      eventqueue_error_handler(EVENTQUEUEERROR_ID, &error, nullptr);
-    }
-    for (const auto& categoryid : categoryids) {
-      auto _category_internal = registry.find(categoryid);
-      if (_category_internal != registry.end()) {
+  _drain_lanes(registry.load(std::memory_order_acquire));
+
+  for (auto& lane : lanes) {
+    for (; lane.head < lane.events.size(); lane.head++) {
+      auto& [id, _dispatch, event] = lane.events[lane.head];
+
+      if (!_dispatch) {
+        // event id has no category anymore
         EventQueueError error{
-          .category = _category_internal->second.category,
-          .reason = QueueNotEmpty,
+          .reason = QueueNotEmptyNoCategory,
           .queue_id = id,
         };
-        eventqueue_error_handler(EVENTQUEUEERROR_ID, &error, _category_internal->second.data);
+        eventqueue_error_handler(EVENTQUEUEERROR_ID, &error, this);
+      } else {
+        for (auto* _category_internal : _dispatch->categories) {
+          EventQueueError error{
+            .category = _category_internal->category.id,
+            .reason = QueueNotEmpty,
+            .queue_id = id,
+          };
+          eventqueue_error_handler(EVENTQUEUEERROR_ID, &error, this);
+        }
       }
+
+      _release_payload(event);
     }
+  }
 
-    if (event.free_data_after_use) {
-      // free the copied data (see: push_event())
-      std::free(event.data);
+  size_t completions = 0;
+  for (auto& mailbox : mailboxes) {
+    while (auto completion = mailbox->completions.front()) {
+      completion->destroy(*completion);
+      mailbox->completions.pop();
+      completions++;
     }
   }
+  if (completions) {
+    auto logger = logger::current();
+    logger->warning("EventQueue is being destructed, but mailboxes still contain {} completions", completions);
+  }
 }
 
-void EventQueue::_push_event_nolock(EventID id, void* data, size_t data_size)
+bool EventQueue::_push_event(EventID id, void* data, size_t data_size, EventQueueOverflowPolicy policy)
 {
-  auto logger = logger::get();
-  logger->trace("push_event(): Event {:#x}", id);
+  MINEKRAF_LOG_TRACE(logger::current(), "push_event(): Event {:#x}", id);
 
-  Event event{data, false};
+  std::pair<EventID, Event> item{id, {}};
+  auto& event = item.second;
+  event.data = data;
 
   if (data && data_size) {
     // store a copy of the data,
-    auto handler_data = std::malloc(data_size);
-    std::memcpy(handler_data, data, data_size);
-    logger->trace("push_event(): malloc {:p}, size: {}", handler_data, data_size);
-    event.data = handler_data;
-    event.free_data_after_use = true;
+    std::memcpy(_reserve_payload(event, data_size, true), data, data_size);
   }
 
-  queue.emplace(id, std::move(event));
+  return _enqueue(std::move(item), policy);
 }
 
-void EventQueue::push_event(EventID id, void* data, size_t data_size)
+void* EventQueue::_reserve_payload(Event& event, size_t size, bool allow_inline)
 {
-  std::lock_guard lock(mutex);
+  if (allow_inline && size <= sizeof(event.buffer)) {
+    event.storage = EventStorage::inline_buffer;
+    inline_payloads.fetch_add(1, std::memory_order_relaxed);
+  } else if (auto block = arena.allocate(size, event.slab)) {
+    event.data = block;
+    event.storage = EventStorage::arena;
+    arena_payloads.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    event.data = ::operator new(size);
+    event.storage = EventStorage::heap;
+    heap_payloads.fetch_add(1, std::memory_order_relaxed);
+  }
+  return event.payload();
+}
 
-  _push_event_nolock(id, data, data_size);
+bool EventQueue::_enqueue(std::pair<EventID, Event>&& item, EventQueueOverflowPolicy policy)
+{
+  item.second.pushed = std::chrono::steady_clock::now();
+  while (!queue.try_push(std::move(item))) {
+    // a handler waiting for room would wait for its own tick() (or the tick()
+    // waiting for its worker) forever
+    if (policy != EventQueueOverflowPolicy::block || dispatching == this) {
+      _release_payload(item.second);
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    std::this_thread::yield();
+  }
+  return true;
 }
 
-size_t EventQueue::tick()
+void EventQueue::_release_payload(Event& event)
+{
+  if (event.destroy) {
+    event.destroy(event.payload());
+    event.destroy = nullptr;
+  }
+
+  switch (event.storage) {
+    case EventStorage::arena:
+      arena.release(event.slab);
+      break;
+    case EventStorage::heap:
+      ::operator delete(event.data);
+      break;
+    default:
+      break;
+  }
+  event.storage = EventStorage::external;
+  event.data = nullptr;
+}
+
+EventQueue::Mailbox& EventQueue::_mailbox()
 {
-  constexpr auto max_timeout = std::chrono::milliseconds::max().count();
-  return tick(max_timeout);
+  // queues are told apart by instance, a new queue may reuse the address of a destroyed one
+  thread_local struct {
+    uint64_t instance = 0;
+    Mailbox* mailbox = nullptr;
+  } cached;
+
+  if (cached.instance == instance) {
+    return *cached.mailbox;
+  }
+
+  const std::lock_guard lock(mailboxes_mutex);
+
+  // thread ids are reused once a thread exited, so is its (drained) mailbox
+  auto owner = std::this_thread::get_id();
+  auto _mailbox = std::find_if(mailboxes.begin(), mailboxes.end(), [&](const auto& mailbox) {
+    return mailbox->owner == owner;
+  });
+  if (_mailbox == mailboxes.end()) {
+    mailboxes.push_back(std::make_unique<Mailbox>(owner, mailbox_capacity));
+    _mailbox = mailboxes.end() - 1;
+  }
+
+  cached.instance = instance;
+  cached.mailbox = _mailbox->get();
+  return *cached.mailbox;
 }
 
-size_t EventQueue::tick(size_t timeout_ms)
+bool EventQueue::push_event(EventID id, void* data, size_t data_size)
 {
-  using namespace std::chrono;
+  // typed event ids differ between runs, handler pushes are repeated on replay
+  if (recorder.recording() && id < EVENTQUEUE_TYPED_ID_BASE && dispatching != this) {
+    recorder.record(id, data, data_size);
+  }
+  return _push_event(id, data, data_size, policy);
+}
 
-  size_t count = 0;
-  auto timeout = milliseconds{timeout_ms};
+bool EventQueue::start_recording(const std::string& path, std::set<EventID> skipped_ids)
+{
+  return recorder.open(path, std::set<uint64_t>(skipped_ids.begin(), skipped_ids.end()));
+}
 
-  auto timepoint = steady_clock::now();
+void EventQueue::stop_recording()
+{
+  recorder.close();
+}
 
-  auto logger = logger::get();
+TimerID EventQueue::push_event_at(EventID id, void* data, size_t data_size, std::chrono::steady_clock::time_point when)
+{
+  const std::lock_guard lock(timers_mutex);
+
+  return timers.schedule(id, data, data_size, when);
+}
+
+TimerID EventQueue::push_event_every(EventID id, void* data, size_t data_size,
+  std::chrono::steady_clock::duration period)
+{
+  const std::lock_guard lock(timers_mutex);
+
+  return timers.schedule(id, data, data_size, std::chrono::steady_clock::now() + period, period);
+}
+
+bool EventQueue::cancel_timer(TimerID timer)
+{
+  const std::lock_guard lock(timers_mutex);
 
-  while (!queue.empty()) {
-    const std::lock_guard lock(mutex);
+  return timers.cancel(timer);
+}
 
-    auto [id, event] = queue.front();
-    queue.pop();
-    logger->trace("EventQueue::tick(): pop {{ {:#x}, {:p} }}", id, static_cast<void*>(event.data));
+const EventQueue::EventDispatch* EventQueue::_find_dispatch(const Registry& snapshot, EventID id)
+{
+  auto _dispatch = snapshot.dispatch.find(id);
+  return _dispatch != snapshot.dispatch.end() ? &_dispatch->second : nullptr;
+}
 
-    EventCategory* category = nullptr;
-    for (auto& [_, _category_internal] : registry) {
-      logger->trace("EventQueue::tick(): - Category {} (id {})", _category_internal.category.name,
-        _category_internal.category.id);
-      auto& _category = _category_internal.category;
-      // find category by event id
-      if (!_category.event_ids.contains(id)) {
+void EventQueue::_drain_lanes(std::shared_ptr<const Registry> snapshot)
+{
+  bool changed = snapshot != lanes_registry;
+
+  for (auto& lane : lanes) {
+    // drop events handled by the previous tick, keep the ones it ran out of
+    // time for in front; compacting only once half of the lane is handled
+    // keeps carrying over cheap
+    if (lane.head == lane.events.size()) {
+      lane.events.clear();
+      lane.head = 0;
+    } else if (lane.head > lane.events.size() / 2) {
+      lane.events.erase(lane.events.begin(), lane.events.begin() + lane.head);
+      lane.head = 0;
+    }
+
+    if (changed) {
+      // the registry changed since the carried over events were resolved
+      for (size_t i = lane.head; i < lane.events.size(); i++) {
+        lane.events[i].dispatch = _find_dispatch(*snapshot, lane.events[i].id);
+      }
+    }
+  }
+
+  if (changed) {
+    // the old snapshot (and the category data only it refers to) is released here
+    lanes_registry = std::move(snapshot);
+    coalesce_pending.assign(lanes_registry->dispatch.size(), std::numeric_limits<size_t>::max());
+  }
+
+  // only take what is queued right now, events pushed while the batch is
+  // being dispatched belong to the next batch
+  size_t coalesced = 0;
+  size_t pending = queue.size_approx();
+
+  size_t waiting = pending;
+  for (const auto& lane : lanes) {
+    waiting += lane.events.size() - lane.head;
+  }
+  depth.store(waiting, std::memory_order_relaxed);
+  if (waiting > max_depth.load(std::memory_order_relaxed)) {
+    max_depth.store(waiting, std::memory_order_relaxed);
+  }
+
+  std::pair<EventID, Event> item;
+  for (; pending > 0 && queue.try_pop(item); pending--) {
+    auto _dispatch = _find_dispatch(*lanes_registry, item.first);
+    auto priority = _dispatch ? _dispatch->priority : EventPriority::background;
+    auto& lane = lanes[static_cast<size_t>(priority)];
+
+    if (_dispatch && _dispatch->coalesce) {
+      auto& position = coalesce_pending[_dispatch->index];
+      if (position == std::numeric_limits<size_t>::max()) {
+        coalesce_touched.push_back(_dispatch->index);
+      } else if (position + 1 == lane.events.size() &&
+                 _dispatch->coalesce(item.first, lane.events[position].event.payload(), item.second.payload())) {
+        // only merge into the last event of the lane, merging past the events
+        // queued in between would reorder them (e.g. motion across a click)
+        _release_payload(item.second);
+        coalesced++;
         continue;
       }
-      category = &_category;
-      logger->trace("EventQueue::tick(): - Event {:#x} <-> Category {} (id {})", id, category->name, category->id);
-      for (auto handler : category->handlers) {
-        logger->trace("EventQueue::tick():   - call handler {:p} for Category {} (id {})", (void*)handler,
-          category->name, category->id);
-        auto err = handler(id, event.data, _category_internal.data);
-        if (err) {
-          EventQueueError error{
-            .category = *category,
-            .reason = HandlerReturnError,
-            .handler_return = err,
-          };
-          _push_event_nolock(EVENTQUEUEERROR_ID, &error, sizeof(error));
-        }
+      // merge following events into this one
+      position = lane.events.size();
+    }
+
+    lane.events.push_back({item.first, _dispatch, std::move(item.second)});
+  }
+
+  for (auto index : coalesce_touched) {
+    coalesce_pending[index] = std::numeric_limits<size_t>::max();
+  }
+  coalesce_touched.clear();
+
+  if (coalesced) {
+    MINEKRAF_LOG_TRACE(logger::current(), "EventQueue::tick(): coalesced {} events", coalesced);
+  }
+}
+
+void EventQueue::_call_handlers(EventID id, void* data, const EventCategoryInternal& category_internal)
+{
+  struct DispatchScope {
+    const EventQueue* previous;
+    explicit DispatchScope(const EventQueue* eventqueue) : previous(std::exchange(dispatching, eventqueue)) {}
+    ~DispatchScope() { dispatching = previous; }
+  } scope(this);
+
+  auto start = std::chrono::steady_clock::now();
+  for (const auto& handler : category_internal.handlers) {
+    auto err = handler(id, data, category_internal.data.get());
+
+    auto end = std::chrono::steady_clock::now();
+    handler.stats->time.record(static_cast<uint64_t>(std::chrono::nanoseconds(end - start).count()));
+    start = end;
+
+    if (err) {
+      handler.stats->errors.fetch_add(1, std::memory_order_relaxed);
+      _report_error(category_internal.category.id, HandlerReturnError, 0, err);
+    }
+  }
+}
+
+size_t EventQueue::_dispatch_event(EventID id, const EventDispatch* _dispatch, Event& event)
+{
+  // the traces fetch the logger themselves, release builds compile them out (see MINEKRAF_LOG_TRACE())
+  size_t count = 0;
+  auto data = event.payload();
+  MINEKRAF_LOG_TRACE(logger::current(), "EventQueue::tick(): pop {{ {:#x}, {:p} }}", id, data);
+
+  if (_dispatch) {
+    auto latency =
+      static_cast<uint64_t>(std::chrono::nanoseconds(std::chrono::steady_clock::now() - event.pushed).count());
+
+    for (auto* _category_internal : _dispatch->categories) {
+      auto category = &_category_internal->category;
+      _count_dispatch(*_category_internal, latency);
+
+      MINEKRAF_LOG_TRACE(logger::current(), "EventQueue::tick(): - Event {:#x} <-> Category {} (id {})", id,
+        category->name, category->id);
+      if (category->thread_safe) {
+        MINEKRAF_LOG_TRACE(logger::current(),
+          "EventQueue::tick():   - queue {} handlers for Category {} (id {}) on the worker pool",
+          _category_internal->handlers.size(), category->name, category->id);
+        parallel_jobs.push_back({id, data, _category_internal});
+      } else {
+        _call_handlers(id, data, *_category_internal);
       }
       count++;
     }
+  } else {
+    MINEKRAF_LOG_TRACE(logger::current(), "EventQueue::tick(): Category not found for event {:#x}", id);
+    if (id == EVENTQUEUEERROR_ID) {
+      // no EventQueueError category?
+      // oh no, how did you manage this?
+      throw std::runtime_error("EventQueueError category is not registered");
+    }
+    _report_error(0, EventCategoryNotFound, id, 0);
+  }
 
-    if (!category) {
-      logger->trace("EventQueue::tick(): Category not found for event {:#x}", id);
-      if (id == EVENTQUEUEERROR_ID) {
-        // no EventQueueError category?
-        // oh no, how did you manage this?
-        throw std::runtime_error("EventQueueError category is not registered");
+  return count;
+}
+
+void EventQueue::_count_dispatch(const EventCategoryInternal& category_internal, uint64_t latency)
+{
+  auto tick_number = ticks.load(std::memory_order_relaxed);
+
+  // the tick counters are only written by the tick() thread, plain loads and stores will do
+  auto& stats = *category_internal.stats;
+  stats.latency.record(latency);
+  uint64_t tick_events = 1;
+  if (stats.last_tick.load(std::memory_order_relaxed) == tick_number) {
+    tick_events = stats.tick_events.load(std::memory_order_relaxed) + 1;
+  } else {
+    stats.last_tick.store(tick_number, std::memory_order_relaxed);
+    stats.ticks.store(stats.ticks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+  stats.tick_events.store(tick_events, std::memory_order_relaxed);
+  if (tick_events > stats.max_tick_events.load(std::memory_order_relaxed)) {
+    stats.max_tick_events.store(tick_events, std::memory_order_relaxed);
+  }
+}
+
+size_t EventQueue::_dispatch_completion(const Registry& snapshot, Completion& completion)
+{
+  MINEKRAF_LOG_TRACE(logger::current(), "EventQueue::drain_completions(): pop {{ {:#x}, {:p} }}", completion.id,
+    completion.payload());
+
+  auto _dispatch = _find_dispatch(snapshot, completion.id);
+  if (!_dispatch) {
+    // nobody subscribed (anymore), the value is destroyed unhandled
+    _report_error(0, EventCategoryNotFound, completion.id, 0);
+    return 0;
+  }
+
+  auto latency =
+    static_cast<uint64_t>(std::chrono::nanoseconds(std::chrono::steady_clock::now() - completion.pushed).count());
+  for (auto* _category_internal : _dispatch->categories) {
+    _count_dispatch(*_category_internal, latency);
+    _call_handlers(completion.id, completion.payload(), *_category_internal);
+  }
+  return _dispatch->categories.size();
+}
+
+size_t EventQueue::drain_completions()
+{
+  {
+    const std::lock_guard lock(mailboxes_mutex);
+
+    // drained without the lock, handlers may post from threads which have no mailbox yet
+    drain_mailboxes.clear();
+    for (auto& mailbox : mailboxes) {
+      drain_mailboxes.push_back(mailbox.get());
+    }
+  }
+
+  auto snapshot = registry.load(std::memory_order_acquire);
+
+  size_t count = 0;
+  for (auto* mailbox : drain_mailboxes) {
+    auto& completions = mailbox->completions;
+    // only take what is posted right now, see tick()
+    for (size_t pending = completions.size_approx(); pending > 0; pending--) {
+      auto completion = completions.front();
+      try {
+        count += _dispatch_completion(*snapshot, *completion);
+      } catch (...) {
+        completion->destroy(*completion);
+        completions.pop();
+        throw;
       }
-      EventQueueError error{
-        .category = {},
-        .reason = EventCategoryNotFound,
-        .queue_id = id,
-      };
-      _push_event_nolock(EVENTQUEUEERROR_ID, &error, sizeof(error));
+      completion->destroy(*completion);
+      completions.pop();
+    }
+  }
+
+  _flush_errors();
+  return count;
+}
+
+void EventQueue::_report_error(EventCategoryID category, int reason, EventID queue_id, int handler_return)
+{
+  const std::lock_guard lock(errors_mutex);
+
+  // a handful of distinct errors per tick at most, a linear search beats hashing
+  for (auto& error : pending_errors) {
+    if (error.category == category && error.reason == reason && error.queue_id == queue_id &&
+        error.handler_return == handler_return) {
+      error.count++;
+      return;
     }
+  }
+  pending_errors.push_back({category, reason, queue_id, handler_return, 1});
+}
 
-    if (event.free_data_after_use) {
-      // free the copied data (see: push_event())
-      logger->trace("EventQueue::tick(): free {:p}", event.data);
-      std::free(event.data);
+void EventQueue::_flush_errors()
+{
+  const std::lock_guard lock(errors_mutex);
+
+  for (const auto& pending : pending_errors) {
+    EventQueueError error{
+      .category = pending.category,
+      .reason = static_cast<EventQueueErrorReason>(pending.reason),
+      .queue_id = pending.queue_id,
+      .handler_return = pending.handler_return,
+      .count = pending.count,
+    };
+    _emit(EVENTQUEUEERROR_ID, error, EventQueueOverflowPolicy::discard_new);
+  }
+  pending_errors.clear();
+}
+
+void EventQueue::_finish_batch(Lane& lane, size_t first)
+{
+  if (!parallel_jobs.empty()) {
+    try {
+      workers.run(parallel_jobs.size(), [this](size_t index) {
+        const auto& job = parallel_jobs[index];
+        _call_handlers(job.id, job.data, *job.category);
+      });
+    } catch (...) {
+      parallel_jobs.clear();
+      throw;
     }
+    parallel_jobs.clear();
+  }
 
-    if (auto delta = steady_clock::now() - timepoint; duration_cast<milliseconds>(delta) > timeout) {
-      logger->trace("EventQueue::tick(): timeout after {}ns", duration_cast<nanoseconds>(delta).count());
+  // give back the copied data (see: push_event())
+  for (size_t i = first; i < lane.head; i++) {
+    _release_payload(lane.events[i].event);
+  }
+}
+
+size_t EventQueue::tick()
+{
+  return tick(std::chrono::microseconds::max());
+}
+
+size_t EventQueue::tick(size_t timeout_ms)
+{
+  using namespace std::chrono;
+
+  constexpr auto max_timeout_ms = static_cast<size_t>(duration_cast<milliseconds>(microseconds::max()).count());
+  if (timeout_ms >= max_timeout_ms) {
+    return tick();
+  }
+  return tick(duration_cast<microseconds>(milliseconds{timeout_ms}));
+}
+
+size_t EventQueue::tick(std::chrono::microseconds budget)
+{
+  using namespace std::chrono;
+
+  size_t count = 0;
+  size_t dispatched = 0;
+
+  auto timepoint = steady_clock::now();
+  ticks.store(ticks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+  auto logger = logger::current();
+
+  if (auto _dropped = dropped.exchange(0, std::memory_order_relaxed)) {
+    logger->warning("EventQueue::tick(): queue was full, dropped {} events", _dropped);
+  }
+
+  {
+    const std::lock_guard lock(timers_mutex);
+
+    timers.advance(timepoint, [this](EventID id, const void* data, size_t data_size) {
+      // the timer keeps its payload, the event gets a copy
+      _push_event(id, const_cast<void*>(data), data_size, EventQueueOverflowPolicy::discard_new);
+    });
+  }
+
+  _drain_lanes(registry.load(std::memory_order_acquire));
+
+  bool over_budget = false;
+  for (auto& lane : lanes) {
+    size_t first = lane.head;
+    while (lane.head < lane.events.size()) {
+      if (dispatched && dispatched % EVENTQUEUE_BUDGET_CHECK_INTERVAL == 0) {
+        _finish_batch(lane, first);
+        first = lane.head;
+
+        if (auto delta = duration_cast<microseconds>(steady_clock::now() - timepoint); delta > budget) {
+          MINEKRAF_LOG_TRACE(logger, "EventQueue::tick(): over budget after {}us, carrying over events", delta.count());
+          over_budget = true;
+          break;
+        }
+      }
+
+      auto& [id, _dispatch, event] = lane.events[lane.head++];
+      count += _dispatch_event(id, _dispatch, event);
+      dispatched++;
+    }
+    _finish_batch(lane, first);
+    if (over_budget) {
       break;
     }
   }
+
+  // one error event per distinct error of this tick
+  _flush_errors();
+
+  tick_time.record(static_cast<uint64_t>(nanoseconds(steady_clock::now() - timepoint).count()));
   return count;
 }
 
+EventQueueAllocStats EventQueue::alloc_stats()
+{
+  auto arena_stats = arena.get_stats();
+  auto _heap_payloads = heap_payloads.load(std::memory_order_relaxed);
+  return {
+    .inline_payloads = inline_payloads.load(std::memory_order_relaxed),
+    .arena_payloads = arena_payloads.load(std::memory_order_relaxed),
+    .heap_payloads = _heap_payloads,
+    .heap_allocations = arena_stats.slab_allocations + _heap_payloads,
+    .arena_slabs = arena_stats.slabs,
+  };
+}
+
+EventCategoryStats EventQueue::_category_stats(const EventCategoryInternal& category_internal)
+{
+  auto& stats = *category_internal.stats;
+
+  EventCategoryStats category_stats{
+    .id = category_internal.category.id,
+    .name = category_internal.category.name,
+    .ticks = stats.ticks.load(std::memory_order_relaxed),
+    .max_tick_events = stats.max_tick_events.load(std::memory_order_relaxed),
+    .latency = stats.latency.snapshot(),
+    .handler_time = 0,
+    .handlers = {},
+  };
+
+  for (size_t i = 0; i < category_internal.handlers.size(); i++) {
+    auto& handler_stats = *category_internal.handlers[i].stats;
+    auto& handler = category_stats.handlers.emplace_back(EventHandlerStats{
+      .index = i,
+      .errors = handler_stats.errors.load(std::memory_order_relaxed),
+      .time = handler_stats.time.snapshot(),
+    });
+    category_stats.handler_time += handler.time.sum;
+  }
+  return category_stats;
+}
+
+EventQueueStats EventQueue::stats()
+{
+  auto snapshot = registry.load(std::memory_order_acquire);
+
+  EventQueueStats queue_stats{
+    .ticks = ticks.load(std::memory_order_relaxed),
+    .depth = depth.load(std::memory_order_relaxed),
+    .max_depth = max_depth.load(std::memory_order_relaxed),
+    .tick_time = tick_time.snapshot(),
+    .categories = {},
+  };
+
+  queue_stats.categories.reserve(snapshot->categories.size());
+  for (const auto& [_, category_internal] : snapshot->categories) {
+    queue_stats.categories.push_back(_category_stats(category_internal));
+  }
+  return queue_stats;
+}
+
+std::optional<EventCategoryStats> EventQueue::category_stats(EventCategoryID id)
+{
+  auto snapshot = registry.load(std::memory_order_acquire);
+
+  if (auto _category_internal = snapshot->categories.find(id); _category_internal != snapshot->categories.end()) {
+    return _category_stats(_category_internal->second);
+  }
+  return {};
+}
+
+void EventQueue::reset_stats()
+{
+  auto snapshot = registry.load(std::memory_order_acquire);
+
+  for (const auto& [_, category_internal] : snapshot->categories) {
+    auto& stats = *category_internal.stats;
+    stats.latency.reset();
+    stats.ticks.store(0, std::memory_order_relaxed);
+    stats.max_tick_events.store(0, std::memory_order_relaxed);
+    for (const auto& handler : category_internal.handlers) {
+      handler.stats->errors.store(0, std::memory_order_relaxed);
+      handler.stats->time.reset();
+    }
+  }
+  max_depth.store(0, std::memory_order_relaxed);
+  tick_time.reset();
+}
+
+void EventQueue::log_stats(size_t count)
+{
+  auto logger = logger::current();
+
+  auto queue_stats = stats();
+  logger->info("EventQueue: {} ticks, tick time mean {}us, p99 {}us, max {}us, max depth {}", queue_stats.ticks,
+    queue_stats.tick_time.mean() / 1000, queue_stats.tick_time.percentile(0.99) / 1000,
+    queue_stats.tick_time.max / 1000, queue_stats.max_depth);
+
+  auto& categories = queue_stats.categories;
+  std::sort(categories.begin(), categories.end(),
+    [](const auto& a, const auto& b) { return a.handler_time > b.handler_time; });
+  if (categories.size() > count) {
+    categories.resize(count);
+  }
+
+  for (const auto& category : categories) {
+    if (!category.latency.count) {
+      continue;
+    }
+    logger->info("EventQueue: - Category {} (id {}): {} events, {:.1f}/tick (max {}), handlers {}us, latency p50 {}us "
+                  "p99 {}us",
+      category.name, category.id, category.latency.count, category.events_per_tick(), category.max_tick_events,
+      category.handler_time / 1000, category.latency.percentile(0.50) / 1000,
+      category.latency.percentile(0.99) / 1000);
+    for (const auto& handler : category.handlers) {
+      logger->info("EventQueue:   - handler {}: {} calls, mean {}ns, p99 {}ns, max {}ns, {} errors", handler.index,
+        handler.time.count, handler.time.mean(), handler.time.percentile(0.99), handler.time.max, handler.errors);
+    }
+  }
+}
+
 bool EventQueue::insert_category(EventCategory&& category)
 {
   return insert_category(std::move(category), nullptr, 0);
@@ -248,9 +834,14 @@ bool EventQueue::insert_category(EventCategory&& category, void* data, size_t da
 {
   const std::lock_guard lock(mutex);
 
-  auto logger = logger::get();
+  auto logger = logger::current();
+
+  auto _registry = _copy_registry_nolock();
+  if (_registry->categories.contains(category.id)) {
+    return false;
+  }
 
-  for (auto& [_, _category_internal] : registry) {
+  for (auto& [_, _category_internal] : _registry->categories) {
     auto& _category = _category_internal.category;
     if (_category.name == category.name) {
       logger->warning(
@@ -261,61 +852,154 @@ bool EventQueue::insert_category(EventCategory&& category, void* data, size_t da
     }
   }
 
-  EventCategoryInternal category_internal{category, data, false};
+  EventCategoryInternal category_internal{std::move(category), {}, {}, std::make_shared<CategoryStats>()};
+  for (auto handler : category_internal.category.handlers) {
+    category_internal.handlers.push_back(Handler::from_func(handler));
+  }
+  category_internal.category.handlers.clear();
 
   if (data && data_size) {
-    // store a copy of the data,
+    // store a copy of the data, freed with the last snapshot referring to it
     auto categorydata = std::malloc(data_size);
     std::memcpy(categorydata, data, data_size);
-    category_internal.data = categorydata;
-    category_internal.free_data_after_use = true;
+    category_internal.data = std::shared_ptr<void>(categorydata, std::free);
+  } else {
+    // borrowed, the caller owns it
+    category_internal.data = std::shared_ptr<void>(data, [](void*) {});
   }
 
-  auto [_, success] = registry.emplace(category.id, std::move(category_internal));
-  return success;
+  auto id = category_internal.category.id;
+  _registry->categories.emplace(id, std::move(category_internal));
+  _publish_nolock(std::move(_registry));
+  return true;
 }
 
 bool EventQueue::remove_category(EventCategoryID id)
 {
   const std::lock_guard lock(mutex);
 
-  auto _category_internal = registry.find(id);
-  if (_category_internal != registry.end()) {
-    if (_category_internal->second.free_data_after_use) {
-      // see: insert_category()
-      std::free(_category_internal->second.data);
+  auto _registry = _copy_registry_nolock();
+  if (!_registry->categories.erase(id)) {
+    return false;
+  }
+
+  std::erase_if(_registry->channels, [id](const auto& channel) { return channel.second == id; });
+  _publish_nolock(std::move(_registry));
+  return true;
+}
+
+std::shared_ptr<EventQueue::Registry> EventQueue::_copy_registry_nolock() const
+{
+  auto current = registry.load(std::memory_order_acquire);
+  if (!current) {
+    return std::make_shared<Registry>();
+  }
+
+  // the dispatch table of the copy would point into the old snapshot, it is
+  // rebuilt by _publish_nolock()
+  auto _registry = std::make_shared<Registry>();
+  _registry->categories = current->categories;
+  _registry->channels = current->channels;
+  return _registry;
+}
+
+void EventQueue::_publish_nolock(std::shared_ptr<Registry> _registry)
+{
+  auto& dispatch = _registry->dispatch;
+  dispatch.clear();
+  // categories are ordered by category id, so every dispatch entry is as well
+  for (const auto& [_, category_internal] : _registry->categories) {
+    auto& category = category_internal.category;
+    for (const auto& event_id : category.event_ids) {
+      auto [_dispatch, inserted] = dispatch.try_emplace(event_id);
+      if (inserted) {
+        _dispatch->second.index = dispatch.size() - 1;
+        _dispatch->second.coalesce = category.coalesce;
+      } else if (_dispatch->second.coalesce != category.coalesce) {
+        // a category which did not opt in (or merges differently) must see every event
+        _dispatch->second.coalesce = nullptr;
+      }
+      _dispatch->second.categories.push_back(&category_internal);
+      _dispatch->second.priority = std::min(_dispatch->second.priority, category.priority);
     }
-    registry.erase(_category_internal);
-    return true;
   }
 
-  return false;
+  registry.store(std::move(_registry), std::memory_order_release);
 }
 
-std::vector<EventCategoryID> EventQueue::_find_categories_nolock(EventID event_id)
+bool EventQueue::set_category_coalesce(EventCategoryID id, EventCoalesceFunc coalesce)
+{
+  const std::lock_guard lock(mutex);
+
+  auto _registry = _copy_registry_nolock();
+  auto _category_internal = _registry->categories.find(id);
+  if (_category_internal == _registry->categories.end()) {
+    return false;
+  }
+
+  _category_internal->second.category.coalesce = coalesce;
+  _publish_nolock(std::move(_registry));
+  return true;
+}
+
+bool EventQueue::set_category_priority(EventCategoryID id, EventPriority priority)
+{
+  const std::lock_guard lock(mutex);
+
+  auto _registry = _copy_registry_nolock();
+  auto _category_internal = _registry->categories.find(id);
+  if (_category_internal == _registry->categories.end()) {
+    return false;
+  }
+
+  _category_internal->second.category.priority = priority;
+  _publish_nolock(std::move(_registry));
+  return true;
+}
+
+bool EventQueue::set_category_thread_safe(EventCategoryID id, bool thread_safe)
+{
+  const std::lock_guard lock(mutex);
+
+  auto _registry = _copy_registry_nolock();
+  auto _category_internal = _registry->categories.find(id);
+  if (_category_internal == _registry->categories.end()) {
+    return false;
+  }
+
+  _category_internal->second.category.thread_safe = thread_safe;
+  _publish_nolock(std::move(_registry));
+  return true;
+}
+
+std::vector<EventCategoryID> EventQueue::find_categories(EventID event_id)
 {
+  auto snapshot = registry.load(std::memory_order_acquire);
+
   std::vector<EventCategoryID> categories;
-  for (const auto& [id, category_internal] : registry) {
-    auto& category = category_internal.category;
-    if (category.event_ids.find(event_id) != category.event_ids.end()) {
-      categories.push_back(id);
+  if (auto _dispatch = _find_dispatch(*snapshot, event_id)) {
+    for (const auto* category_internal : _dispatch->categories) {
+      categories.push_back(category_internal->category.id);
     }
   }
   return categories;
 }
 
-std::vector<EventCategoryID> EventQueue::find_categories(EventID event_id)
+std::optional<std::string> EventQueue::find_category_name(EventCategoryID id)
 {
-  const std::lock_guard lock(mutex);
+  auto snapshot = registry.load(std::memory_order_acquire);
 
-  return _find_categories_nolock(event_id);
+  if (auto _category_internal = snapshot->categories.find(id); _category_internal != snapshot->categories.end()) {
+    return _category_internal->second.category.name;
+  }
+  return {};
 }
 
 std::optional<EventCategoryID> EventQueue::find_category(std::string_view name)
 {
-  const std::lock_guard lock(mutex);
+  auto snapshot = registry.load(std::memory_order_acquire);
 
-  for (const auto& [id, category_internal] : registry) {
+  for (const auto& [id, category_internal] : snapshot->categories) {
     auto& category = category_internal.category;
     if (category.name == name) {
       return id;
@@ -326,13 +1010,13 @@ std::optional<EventCategoryID> EventQueue::find_category(std::string_view name)
 
 EventCategoryID EventQueue::find_next_free_category(EventCategoryID start)
 {
-  const std::lock_guard lock(mutex);
+  auto snapshot = registry.load(std::memory_order_acquire);
 
-  auto _category = registry.find(start);
+  auto _category = snapshot->categories.find(start);
   // https://en.cppreference.com/w/cpp/container/map
   // keys are sorted by std::less<KeyT>, so we can iterate without calling find
   // on every iteration
-  while (_category != registry.end() && start == _category->first) {
+  while (_category != snapshot->categories.end() && start == _category->first) {
     start++;
     _category++;
   }
@@ -344,13 +1028,17 @@ bool EventQueue::append_category_event(EventCategoryID id, EventID event_id)
 {
   const std::lock_guard lock(mutex);
 
-  auto _category_internal = registry.find(id);
-  if (_category_internal == registry.end()) {
+  auto _registry = _copy_registry_nolock();
+  auto _category_internal = _registry->categories.find(id);
+  if (_category_internal == _registry->categories.end()) {
     return false;
   }
 
   auto& category = _category_internal->second.category;
   auto [_, success] = category.event_ids.insert(event_id);
+  if (success) {
+    _publish_nolock(std::move(_registry));
+  }
   return success;
 }
 
@@ -358,50 +1046,60 @@ bool EventQueue::remove_category_event(EventCategoryID id, EventID event_id)
 {
   const std::lock_guard lock(mutex);
 
-  auto _category_internal = registry.find(id);
-  if (_category_internal == registry.end()) {
+  auto _registry = _copy_registry_nolock();
+  auto _category_internal = _registry->categories.find(id);
+  if (_category_internal == _registry->categories.end()) {
     return false;
   }
 
   auto& category = _category_internal->second.category;
-  return category.event_ids.erase(event_id);
+  if (!category.event_ids.erase(event_id)) {
+    return false;
+  }
+  _publish_nolock(std::move(_registry));
+  return true;
 }
 
 size_t EventQueue::register_handler(EventCategoryID id, EventHandlerFunc handler)
 {
   const std::lock_guard lock(mutex);
 
-  auto logger = logger::get();
+  auto logger = logger::current();
 
-  auto _category_internal = registry.find(id);
-  if (_category_internal == registry.end()) {
+  auto _registry = _copy_registry_nolock();
+  auto _category_internal = _registry->categories.find(id);
+  if (_category_internal == _registry->categories.end()) {
     logger->error("EventQueue::register_handler(): Category id {} does not exist", id);
     return std::numeric_limits<size_t>::max();
   }
 
-  auto& handlers = _category_internal->second.category.handlers;
-  handlers.push_back(std::move(handler));
-  return handlers.size();
+  auto& handlers = _category_internal->second.handlers;
+  handlers.push_back(Handler::from_func(handler));
+  auto index = handlers.size();
+  _publish_nolock(std::move(_registry));
+  return index;
 }
 
 bool EventQueue::remove_handler(EventCategoryID id, size_t index)
 {
   const std::lock_guard lock(mutex);
 
-  auto logger = logger::get();
+  auto logger = logger::current();
 
-  auto _category_internal = registry.find(id);
-  if (_category_internal == registry.end()) {
+  auto _registry = _copy_registry_nolock();
+  auto _category_internal = _registry->categories.find(id);
+  if (_category_internal == _registry->categories.end()) {
     logger->error("EventQueue::remove_handler(): Category id {} does not exist", id);
     return false;
   }
 
-  auto& handlers = _category_internal->second.category.handlers;
+  auto& handlers = _category_internal->second.handlers;
   if (index >= handlers.size()) {
     logger->error("EventQueue::remove_handler(): Handler index {} is out-of-range", index);
     return false;
   }
   handlers.erase(handlers.begin() + index);
+  _publish_nolock(std::move(_registry));
   return true;
 }
 
@@ -409,16 +1107,18 @@ bool EventQueue::remove_handlers(EventCategoryID id)
 {
   const std::lock_guard lock(mutex);
 
-  auto logger = logger::get();
+  auto logger = logger::current();
 
-  auto _category_internal = registry.find(id);
-  if (_category_internal == registry.end()) {
+  auto _registry = _copy_registry_nolock();
+  auto _category_internal = _registry->categories.find(id);
+  if (_category_internal == _registry->categories.end()) {
     logger->error("EventQueue::remove_handlers(): Category id {} does not exist", id);
     return false;
   }
 
-  auto& handlers = _category_internal->second.category.handlers;
+  auto& handlers = _category_internal->second.handlers;
   handlers.clear();
+  _publish_nolock(std::move(_registry));
   return true;
 }
 
@@ -426,17 +1126,28 @@ EventHandlerFunc EventQueue::pop_handler(EventCategoryID id)
 {
   const std::lock_guard lock(mutex);
 
-  auto logger = logger::get();
+  auto logger = logger::current();
 
-  auto _category_internal = registry.find(id);
-  if (_category_internal == registry.end()) {
+  auto _registry = _copy_registry_nolock();
+  auto _category_internal = _registry->categories.find(id);
+  if (_category_internal == _registry->categories.end()) {
     logger->error("EventQueue::pop_handler(): Category id {} does not exist", id);
     return nullptr;
   }
 
-  auto& handlers = _category_internal->second.category.handlers;
-  auto handler = handlers.back();
-  handlers.erase(handlers.end());
+  auto& handlers = _category_internal->second.handlers;
+  if (handlers.empty()) {
+    logger->error("EventQueue::pop_handler(): Category id {} has no handlers", id);
+    return nullptr;
+  }
+  if (!handlers.back().func) {
+    logger->error("EventQueue::pop_handler(): last handler of Category id {} was added by subscribe(), use "
+                  "remove_handler()", id);
+    return nullptr;
+  }
+  auto handler = handlers.back().func;
+  handlers.pop_back();
+  _publish_nolock(std::move(_registry));
   return handler;
 }
 
@@ -444,20 +1155,76 @@ EventHandlerFunc EventQueue::pop_handler(EventCategoryID id, size_t index)
 {
   const std::lock_guard lock(mutex);
 
-  auto logger = logger::get();
+  auto logger = logger::current();
 
-  auto _category_internal = registry.find(id);
-  if (_category_internal == registry.end()) {
+  auto _registry = _copy_registry_nolock();
+  auto _category_internal = _registry->categories.find(id);
+  if (_category_internal == _registry->categories.end()) {
     logger->error("EventQueue::pop_handler(): Category id {} does not exist", id);
     return nullptr;
   }
 
-  auto& handlers = _category_internal->second.category.handlers;
+  auto& handlers = _category_internal->second.handlers;
   if (index >= handlers.size()) {
     logger->error("EventQueue::pop_handler(): Handler index {} is out-of-range", index);
     return nullptr;
   }
-  auto handler = handlers.at(index);
+  if (!handlers[index].func) {
+    logger->error("EventQueue::pop_handler(): Handler index {} was added by subscribe(), use remove_handler()",
+      index);
+    return nullptr;
+  }
+  auto handler = handlers[index].func;
   handlers.erase(handlers.begin() + index);
+  _publish_nolock(std::move(_registry));
   return handler;
 }
+
+size_t EventQueue::_subscribe(EventID id, const char* type_name, Handler&& handler)
+{
+  const std::lock_guard lock(mutex);
+
+  auto logger = logger::current();
+
+  auto _registry = _copy_registry_nolock();
+  auto _channel = _registry->channels.find(id);
+  if (_channel == _registry->channels.end()) {
+    // first subscriber, create the channel category
+    EventCategoryID category_id = std::numeric_limits<EventCategoryID>::max() / 2;
+    while (_registry->categories.contains(category_id)) {
+      category_id++;
+    }
+
+    EventCategoryInternal category_internal{
+      {
+        .id = category_id,
+        .name = std::string("channel<") + type_name + ">",
+        .event_ids = {id},
+        .handlers = {},
+      },
+      {},
+      {},
+      std::make_shared<CategoryStats>(),
+    };
+    logger->trace("EventQueue::subscribe(): creating Category {} (id {}) for Event {:#x}",
+      category_internal.category.name, category_id, id);
+    _registry->categories.emplace(category_id, std::move(category_internal));
+    _channel = _registry->channels.emplace(id, category_id).first;
+  }
+
+  auto& handlers = _registry->categories.at(_channel->second).handlers;
+  handlers.push_back(std::move(handler));
+  auto index = handlers.size();
+  _publish_nolock(std::move(_registry));
+  return index;
+}
+
+std::optional<EventCategoryID> EventQueue::_channel(EventID id)
+{
+  auto snapshot = registry.load(std::memory_order_acquire);
+
+  if (auto _channel = snapshot->channels.find(id); _channel != snapshot->channels.end()) {
+    return _channel->second;
+  }
+  return {};
+}
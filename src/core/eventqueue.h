@@ -1,19 +1,82 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <vector>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <new>
 #include <optional>
 #include <set>
 #include <string>
-#include <queue>
+#include <thread>
+#include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
+
+#include "eventrecorder.h"
+#include "eventstats.h"
+#include "ringbuffer.h"
+#include "slabarena.h"
+#include "threadpool.h"
+#include "timerwheel.h"
+
+#ifndef MINEKRAF_EVENTQUEUE_INLINE_SIZE
+#define MINEKRAF_EVENTQUEUE_INLINE_SIZE 128
+#endif
 
 namespace tedlhy::minekraf {
 
 using EventCategoryID = ssize_t;
 using EventID = size_t;
 
+/// Event payloads up to this size are stored inside the queue itself
+constexpr size_t EVENTQUEUE_INLINE_SIZE = MINEKRAF_EVENTQUEUE_INLINE_SIZE;
+
+/// Event ids handed out to typed events start here (see EventTraits)
+constexpr EventID EVENTQUEUE_TYPED_ID_BASE = EventID{1} << (sizeof(EventID) * 8 - 2);
+
+/// see typed_event_id()
+EventID _next_typed_event_id();
+
+/**
+ * Get the event id of a typed event.
+ *
+ * Every type gets its own id from the typed id range on first use; ids are
+ * only stable within one run of the program.
+ */
+template<typename T>
+EventID typed_event_id()
+{
+  static const EventID id = _next_typed_event_id();
+  return id;
+}
+
+/**
+ * Compile-time event type traits, picks the channel of EventQueue::emit<T>()
+ * and EventQueue::subscribe<T>().
+ *
+ * Specialize it to bind an event type to a fixed event id, e.g. to receive
+ * SDL events pushed by id as their SDL event structure:
+ *
+ *   template<>
+ *   struct EventTraits<SDL_QuitEvent> {
+ *     static EventID id() { return SDL_EVENT_QUIT; }
+ *   };
+ */
+template<typename T>
+struct EventTraits {
+  static EventID id()
+  {
+    return typed_event_id<T>();
+  }
+};
+
 /**
  * int eventCategoryHandler(EventID id, void* eventdata, void* categorydata);
  *
@@ -23,39 +86,449 @@ using EventID = size_t;
  */
 using EventHandlerFunc = int (*)(EventID, void*, void*);
 
+/**
+ * bool eventCategoryCoalesce(EventID id, void* queued, const void* incoming);
+ *
+ * Called by EventQueue::tick() when an event arrives while an event with the
+ * same id is the last one waiting in its lane in the same tick (events queued
+ * in between are never jumped over). Merge the incoming payload into the
+ * queued one and return true to drop the incoming event, or return false to
+ * keep both (e.g. the events come from different devices).
+ */
+using EventCoalesceFunc = bool (*)(EventID, void*, const void*);
+
+/// EventCoalesceFunc which keeps only the latest payload of type T
+template<typename T>
+bool coalesce_keep_last(EventID, void* queued, const void* incoming)
+{
+  *static_cast<T*>(queued) = *static_cast<const T*>(incoming);
+  return true;
+}
+
+/**
+ * Dispatch priority of a category, EventQueue::tick() dispatches the events
+ * of higher priority lanes first (input first, background last).
+ *
+ * An event watched by several categories is dispatched in the lane of its
+ * highest priority category.
+ */
+enum class EventPriority : uint8_t {
+  input,
+  window,
+  gameplay,
+  background,
+};
+
+constexpr size_t EVENTQUEUE_PRIORITY_COUNT = static_cast<size_t>(EventPriority::background) + 1;
+
+/// tick() checks its time budget after every this many events
+constexpr size_t EVENTQUEUE_BUDGET_CHECK_INTERVAL = 8;
+
 struct EventCategory {
   EventCategoryID id;
   std::string name;
   std::set<EventID> event_ids;
   std::vector<EventHandlerFunc> handlers;
+  EventPriority priority = EventPriority::gameplay;
+  /**
+   * Merges queued events of the same id, nullptr: every event is dispatched.
+   * Events are only coalesced if every category watching their id sets the
+   * same function, otherwise all categories get every event.
+   */
+  EventCoalesceFunc coalesce = nullptr;
+  bool thread_safe = false;  // handlers may run on the worker pool, see EventQueue::tick()
+};
+
+/**
+ * What push_event() does when the queue is full.
+ *
+ * - discard_new: the new event is dropped and push_event() returns false, the
+ *   drop count is reported by the next tick()
+ * - block: push_event() yields until the consumer made room; producers still
+ *   never wait for a lock, but they do wait for tick() to drain the queue
+ *
+ * Events pushed from inside tick() (error events, and events pushed by
+ * handlers, also on the worker pool) are always discarded when the queue is
+ * full, tick() cannot wait for itself.
+ */
+enum class EventQueueOverflowPolicy {
+  discard_new,
+  block,
+};
+
+struct EventQueueInitParams {
+  size_t capacity = 4096;  // rounded up to a power of two
+  EventQueueOverflowPolicy policy = EventQueueOverflowPolicy::discard_new;
+  size_t arena_slab_size = 64 * 1024;  // payloads larger than this are heap allocated
+  size_t worker_count = 2;  // workers for thread-safe categories, 0 runs them on the tick() thread
+  size_t mailbox_capacity = 256;  // completions per posting thread, see EventQueue::post()
+};
+
+/**
+ * Payload allocation counters, see EventQueue::alloc_stats().
+ *
+ * In steady state only the payload counters should grow, heap_allocations
+ * stops growing once enough slabs have been allocated.
+ */
+struct EventQueueAllocStats {
+  size_t inline_payloads = 0;  // payloads copied into the event itself
+  size_t arena_payloads = 0;  // payloads copied into a recycled slab
+  size_t heap_payloads = 0;  // payloads too large for a slab
+  size_t heap_allocations = 0;  // slab allocations + heap payloads
+  size_t arena_slabs = 0;  // slabs currently owned by the queue
+};
+
+/// Counters of one handler of a category, see EventQueue::stats()
+struct EventHandlerStats {
+  size_t index = 0;  // position in the category's handler list
+  uint64_t errors = 0;  // calls which returned an error code
+  EventHistogram time;  // execution time in ns, time.count is the call count
+};
+
+/**
+ * Counters of one category, see EventQueue::stats().
+ *
+ * Events are counted when the category is dispatched, for thread-safe
+ * categories that is when their handlers are queued for the worker pool.
+ */
+struct EventCategoryStats {
+  EventCategoryID id = 0;
+  std::string name;
+  uint64_t ticks = 0;  // ticks which dispatched events to the category
+  uint64_t max_tick_events = 0;  // most events dispatched to the category in one tick
+  EventHistogram latency;  // time from push to dispatch in ns, latency.count is the event count
+  uint64_t handler_time = 0;  // ns spent in the handlers, summed over handlers
+  std::vector<EventHandlerStats> handlers;
+
+  /// Average events per tick which had events for the category
+  double events_per_tick() const
+  {
+    return ticks ? static_cast<double>(latency.count) / static_cast<double>(ticks) : 0.0;
+  }
+};
+
+/// Counters of the whole queue, see EventQueue::stats()
+struct EventQueueStats {
+  uint64_t ticks = 0;
+  uint64_t depth = 0;  // events waiting when the last tick started, carried over ones included
+  uint64_t max_depth = 0;
+  EventHistogram tick_time;  // duration of tick() in ns
+  std::vector<EventCategoryStats> categories;  // ordered by category id
 };
 
 class EventQueue {
+  enum class EventStorage : uint8_t {
+    external,  // data is owned by whoever pushed the event (data_size == 0)
+    inline_buffer,
+    arena,
+    heap,
+  };
+
   struct Event {
     void* data = nullptr;
-    bool free_data_after_use = false;
+    void (*destroy)(void*) = nullptr;  // destructor of a typed payload (see emit())
+    EventStorage storage = EventStorage::external;
+    SlabArena::SlabIndex slab = 0;
+    std::chrono::steady_clock::time_point pushed;  // see EventCategoryStats::latency
+    alignas(std::max_align_t) std::byte buffer[EVENTQUEUE_INLINE_SIZE];
+
+    /// inline payloads move with the event, so always go through payload()
+    void* payload()
+    {
+      return storage == EventStorage::inline_buffer ? buffer : data;
+    }
+  };
+
+  /// see EventHandlerStats, shared by every snapshot holding the handler
+  struct HandlerStats {
+    std::atomic<uint64_t> errors{0};
+    AtomicHistogram time;
+  };
+
+  /**
+   * see EventCategoryStats, shared by every snapshot holding the category.
+   *
+   * Only the tick() thread writes the tick counters, the atomics let stats()
+   * read them from any thread.
+   */
+  struct CategoryStats {
+    AtomicHistogram latency;
+    std::atomic<uint64_t> ticks{0};
+    std::atomic<uint64_t> max_tick_events{0};
+    std::atomic<uint64_t> tick_events{0};  // events dispatched in last_tick
+    std::atomic<uint64_t> last_tick{0};  // tick which last dispatched events to the category
+  };
+
+  /**
+   * Type-erased event handler, both EventHandlerFunc and subscribe()
+   * callables are stored as one.
+   *
+   * Callables are allocated once when subscribing and shared between copies,
+   * calling a handler never allocates.
+   */
+  struct Handler {
+    int (*invoke)(const Handler& self, EventID id, void* eventdata, void* categorydata) = nullptr;
+    EventHandlerFunc func = nullptr;  // only set for plain function handlers
+    std::shared_ptr<void> callable;
+    std::shared_ptr<HandlerStats> stats;  // allocated with the handler, like callable
+
+    int operator()(EventID id, void* eventdata, void* categorydata) const
+    {
+      return invoke(*this, id, eventdata, categorydata);
+    }
+
+    static Handler from_func(EventHandlerFunc func);
+
+    template<typename T, typename F>
+    static Handler from_callable(F&& fn)
+    {
+      using Fn = std::decay_t<F>;
+      static_assert(std::is_invocable_v<Fn&, T&>, "event handler must be invocable with T&");
+
+      Handler handler;
+      handler.callable = std::make_shared<Fn>(std::forward<F>(fn));
+      handler.stats = std::make_shared<HandlerStats>();
+      handler.invoke = [](const Handler& self, EventID, void* eventdata, void*) -> int {
+        auto& _fn = *static_cast<Fn*>(self.callable.get());
+        auto& event = *static_cast<T*>(eventdata);
+        if constexpr (std::is_void_v<std::invoke_result_t<Fn&, T&>>) {
+          std::invoke(_fn, event);
+          return 0;
+        } else {
+          return static_cast<int>(std::invoke(_fn, event));
+        }
+      };
+      return handler;
+    }
   };
 
   struct EventCategoryInternal {
-    EventCategory category;
-    void* data = nullptr;
-    bool free_data_after_use = false;
+    EventCategory category;  // category.handlers is moved into handlers
+    std::vector<Handler> handlers;
+    std::shared_ptr<void> data;  // shared by the snapshots, owned copies are freed with the last one
+    std::shared_ptr<CategoryStats> stats;  // shared by the snapshots like data
   };
 
-  std::map<EventCategoryID, EventCategoryInternal> registry;
-  std::queue<std::pair<EventID, Event>> queue;
-  std::mutex mutex;
+  /// categories watching an event id, ordered by category id
+  struct EventDispatch {
+    std::vector<const EventCategoryInternal*> categories;
+    EventPriority priority = EventPriority::background;  // highest priority of categories
+    EventCoalesceFunc coalesce = nullptr;  // shared by all categories, nullptr if any differs
+    size_t index = 0;  // dense index of the entry, see coalesce_pending
+  };
+
+  /**
+   * Immutable snapshot of the categories, see registry.
+   *
+   * The dispatch table points into the categories of the same snapshot.
+   */
+  struct Registry {
+    std::map<EventCategoryID, EventCategoryInternal> categories;
+    std::unordered_map<EventID, EventDispatch> dispatch;
+    std::unordered_map<EventID, EventCategoryID> channels;  // typed event id -> channel category
+  };
+
+  /// event taken from the queue by tick(), see _drain_lanes()
+  struct BatchEvent {
+    EventID id;
+    const EventDispatch* dispatch;  // nullptr if no category watches id
+    Event event;
+  };
 
-  /// see push_event()
-  void _push_event_nolock(EventID id, void* data, size_t data_size);
+  /// handlers of a thread-safe category to run on the worker pool
+  struct ParallelJob {
+    EventID id;
+    void* data;
+    const EventCategoryInternal* category;
+  };
 
-  /// see find_categories()
-  std::vector<EventCategoryID> _find_categories_nolock(EventID event_id);
+  /// error reported during the current tick, see _report_error()
+  struct PendingError {
+    EventCategoryID category;
+    int reason;  // EventQueueErrorReason
+    EventID queue_id;
+    int handler_return;
+    size_t count;
+  };
+
+  /**
+   * Value posted with post(), constructed in place in its mailbox cell and
+   * destroyed there after its handlers returned.
+   */
+  struct Completion {
+    EventID id = 0;
+    void* data = nullptr;  // heap payload, nullptr if the payload is in buffer
+    void (*destroy)(Completion& self) = nullptr;
+    std::chrono::steady_clock::time_point pushed;
+    alignas(std::max_align_t) std::byte buffer[EVENTQUEUE_INLINE_SIZE];
+
+    void* payload()
+    {
+      return data ? data : buffer;
+    }
+  };
+
+  /// completions of one posting thread, see _mailbox()
+  struct Mailbox {
+    std::thread::id owner;
+    SPSCRingBuffer<Completion> completions;
+
+    Mailbox(std::thread::id owner, size_t capacity) : owner(owner), completions(capacity) {}
+  };
+
+  /// events of one priority, carried over events stay in front
+  struct Lane {
+    std::vector<BatchEvent> events;
+    size_t head = 0;  // next event to dispatch
+  };
+
+  /**
+   * Current registry snapshot (RCU): tick() loads it once without locking and
+   * keeps it alive as long as it dispatches with it. Writers copy it, change
+   * the copy and publish it, serialized by mutex.
+   */
+  std::atomic<std::shared_ptr<const Registry>> registry;
+  MPSCRingBuffer<std::pair<EventID, Event>> queue;
+  std::array<Lane, EVENTQUEUE_PRIORITY_COUNT> lanes;  // events being dispatched, owned by tick()
+  std::shared_ptr<const Registry> lanes_registry;  // snapshot the events in lanes were resolved with
+  std::vector<size_t> coalesce_pending;  // EventDispatch::index -> position in lane of the event to merge into
+  std::vector<size_t> coalesce_touched;  // indices of coalesce_pending to reset after draining
+  std::atomic<size_t> dropped;
+  SlabArena arena;
+  std::atomic<size_t> inline_payloads;
+  std::atomic<size_t> arena_payloads;
+  std::atomic<size_t> heap_payloads;
+  std::mutex mutex;  // serializes registry writers, tick() and the queue are lock-free
+  std::vector<PendingError> pending_errors;  // keeps its capacity, reporting does not allocate in steady state
+  std::mutex errors_mutex;  // guards pending_errors, the workers report errors as well
+  ThreadPool workers;
+  std::vector<ParallelJob> parallel_jobs;  // jobs of the events dispatched since the last barrier
+  TimerWheel timers;
+  std::mutex timers_mutex;  // guards timers
+  EventRecorder recorder;
+  std::atomic<uint64_t> ticks;  // ticks started, the current tick is ticks (see CategoryStats::last_tick)
+  std::atomic<uint64_t> depth;
+  std::atomic<uint64_t> max_depth;
+  AtomicHistogram tick_time;
+  const uint64_t instance;  // unique per queue, identifies the queue in the thread-local mailbox cache
+  size_t mailbox_capacity;
+  std::vector<std::unique_ptr<Mailbox>> mailboxes;  // one per posting thread, kept until the queue is destroyed
+  std::mutex mailboxes_mutex;  // guards mailboxes, only taken by a thread's first post()
+  std::vector<Mailbox*> drain_mailboxes;  // mailboxes being drained, owned by drain_completions()
+
+  EventQueueOverflowPolicy policy;
+
+  /// see push_event(), tick() pushes with discard_new since it can't wait for itself
+  bool _push_event(EventID id, void* data, size_t data_size, EventQueueOverflowPolicy policy);
+
+  /**
+   * Reserve payload storage for event, see push_event() for where it comes
+   * from. Pass `allow_inline` = false for payloads which may not be moved
+   * with memcpy.
+   */
+  void* _reserve_payload(Event& event, size_t size, bool allow_inline);
+
+  /// push event with reserved payload, releases the payload if it was dropped
+  bool _enqueue(std::pair<EventID, Event>&& item, EventQueueOverflowPolicy policy);
+
+  /// see emit()
+  template<typename T>
+  bool _emit(EventID id, T&& value, EventQueueOverflowPolicy policy)
+  {
+    using U = std::remove_cvref_t<T>;
+    static_assert(alignof(U) <= alignof(std::max_align_t), "over-aligned event types are not supported");
+
+    std::pair<EventID, Event> item{id, {}};
+    auto& event = item.second;
+    // only trivially copyable payloads may ride inside the event, the queue
+    // moves events around with memcpy
+    auto storage = _reserve_payload(event, sizeof(U), std::is_trivially_copyable_v<U>);
+    new (storage) U(std::forward<T>(value));
+    if constexpr (!std::is_trivially_destructible_v<U>) {
+      event.destroy = [](void* payload) { static_cast<U*>(payload)->~U(); };
+    }
+    return _enqueue(std::move(item), policy);
+  }
+
+  /**
+   * Mailbox of the calling thread, created on its first call; later calls
+   * only check a thread-local cache.
+   */
+  Mailbox& _mailbox();
+
+  /// give back the storage of a copied payload
+  void _release_payload(Event& event);
+
+  /**
+   * Move the events currently in the queue into their priority lanes, behind
+   * the events carried over from the previous tick, resolving them with
+   * `snapshot`.
+   *
+   * Events of coalescing categories are merged into the event of the same id
+   * drained earlier in the same call.
+   *
+   * Like the other dispatch helpers, only called by the consumer thread.
+   */
+  void _drain_lanes(std::shared_ptr<const Registry> snapshot);
+
+  /**
+   * Call the handlers of event, the handlers of thread-safe categories are
+   * queued in parallel_jobs instead, see _finish_batch().
+   *
+   * This method returns the count of categories handled.
+   */
+  size_t _dispatch_event(EventID id, const EventDispatch* _dispatch, Event& event);
+
+  /// run the queued parallel jobs, then release the payloads of lane events [first, head)
+  void _finish_batch(Lane& lane, size_t first);
+
+  /**
+   * Count an error of the current tick, errors with the same category,
+   * reason, event id and handler return value are reported as one error
+   * event by _flush_errors().
+   */
+  void _report_error(EventCategoryID category, int reason, EventID queue_id, int handler_return);
+
+  /// push one error event per distinct error of the tick
+  void _flush_errors();
+
+  /// count an event dispatched to a category, see CategoryStats
+  void _count_dispatch(const EventCategoryInternal& category_internal, uint64_t latency);
+
+  /// call the handlers of every category watching a completion, see drain_completions()
+  size_t _dispatch_completion(const Registry& snapshot, Completion& completion);
+
+  /// call the handlers of a category, reporting their errors and timing them
+  void _call_handlers(EventID id, void* data, const EventCategoryInternal& category_internal);
+
+  /// snapshot the counters of a category
+  static EventCategoryStats _category_stats(const EventCategoryInternal& category_internal);
+
+  /// dispatch table entry of event id, or nullptr
+  static const EventDispatch* _find_dispatch(const Registry& snapshot, EventID id);
+
+  /// see subscribe()
+  size_t _subscribe(EventID id, const char* type_name, Handler&& handler);
+
+  /// see channel()
+  std::optional<EventCategoryID> _channel(EventID id);
+
+  /// copy of the current registry for a writer to change, see _publish_nolock()
+  std::shared_ptr<Registry> _copy_registry_nolock() const;
+
+  /**
+   * Rebuild the EventID -> category dispatch table of the changed copy and
+   * make it the current registry.
+   *
+   * Must be called after every change to a copy, tick() only ever sees
+   * published snapshots.
+   */
+  void _publish_nolock(std::shared_ptr<Registry> _registry);
 
 public:
   static EventQueue& get();
 
-  EventQueue();
+  EventQueue(EventQueueInitParams params = {});
   ~EventQueue();
 
   /**
@@ -66,17 +539,248 @@ public:
    *
    * Pass `data_size` > 0 to tell the EventQueue to copy the value of data and
    * free the memory of the copied data pointer after the event has been
-   * processed and popped from the queue.
+   * processed and popped from the queue. Copies up to EVENTQUEUE_INLINE_SIZE
+   * bytes are stored in the queue itself, larger ones in recycled slabs, so
+   * pushing does not allocate in steady state.
+   *
+   * This method may be called from any thread. The push into the queue is
+   * lock-free, but a payload larger than EVENTQUEUE_INLINE_SIZE takes the
+   * slab arena's mutex, and an active recording (see start_recording())
+   * takes the recorder's mutex.
+   *
+   * This method returns false if the event was dropped because the queue was
+   * full (see EventQueueOverflowPolicy).
+   */
+  bool push_event(EventID id, void* data, size_t data_size);
+
+  /**
+   * Record every event pushed with push_event() from now on to the file at
+   * path, see EventRecorder for the format and EventReplay to play it back.
+   *
+   * Only events coming from outside are recorded: events pushed by handlers,
+   * timers and emit() are produced again when the recording is replayed, and
+   * events with external data (`data_size` = 0) are skipped. Payloads are
+   * recorded byte for byte, events whose payload holds pointers (strings
+   * owned by SDL, user data) must be listed in `skipped_ids`, their pointers
+   * would dangle on replay.
+   *
+   * This method returns false if the file could not be opened.
+   */
+  bool start_recording(const std::string& path, std::set<EventID> skipped_ids = {});
+
+  /// Stop recording and flush the recording file
+  void stop_recording();
+
+  /**
+   * Push event onto the queue at (or shortly after) `when`.
+   *
+   * The payload is copied when the timer is scheduled, the timer can't keep
+   * track of borrowed pointers; with `data_size` = 0 the event is pushed
+   * without data. Timers are checked at the start
+   * of every tick(), so the event is handled in the first tick after `when`,
+   * with the resolution of TimerWheel::resolution.
+   *
+   * This method is thread-safe.
+   *
+   * This method returns the id of the timer, see cancel_timer().
+   */
+  TimerID push_event_at(EventID id, void* data, size_t data_size, std::chrono::steady_clock::time_point when);
+
+  /**
+   * Push event onto the queue every `period`, starting one period from now.
+   *
+   * Periods missed because tick() was not called in time are skipped, not
+   * pushed in a burst.
+   *
+   * This method is thread-safe.
+   *
+   * This method returns the id of the timer, see cancel_timer().
+   */
+  TimerID push_event_every(EventID id, void* data, size_t data_size, std::chrono::steady_clock::duration period);
+
+  /**
+   * Cancel a timer started with push_event_at() or push_event_every().
+   *
+   * Events which have already been pushed by the timer are still handled.
+   *
+   * This method returns true if the timer was pending, false otherwise.
+   */
+  bool cancel_timer(TimerID timer);
+
+  /**
+   * Push typed event onto the queue.
+   *
+   * The value is moved into the queue's payload storage and destroyed after
+   * the event has been handled (or dropped); it is delivered to the handlers
+   * of the EventTraits<T>::id() channel, see subscribe().
+   *
+   * This method may be called from any thread. The push into the queue is
+   * lock-free, but a value which is not trivially copyable or larger than
+   * EVENTQUEUE_INLINE_SIZE takes the slab arena's mutex.
+   *
+   * This method returns false if the event was dropped because the queue was
+   * full (see EventQueueOverflowPolicy).
+   */
+  template<typename T>
+  bool emit(T&& value)
+  {
+    return _emit(EventTraits<std::remove_cvref_t<T>>::id(), std::forward<T>(value), policy);
+  }
+
+  /**
+   * Post a typed result to the main thread, e.g. a finished chunk mesh from
+   * a worker.
+   *
+   * Every thread posts into its own mailbox, a single-producer ring of
+   * `mailbox_capacity` cells (see EventQueueInitParams), so posting is
+   * wait-free once the thread's mailbox exists: the first post() of a thread
+   * takes a lock to create it. The value is move-constructed right into its
+   * cell and handed to the handlers of the EventTraits<T>::id() channel (see
+   * subscribe()) in place, so move-only types such as std::unique_ptr work
+   * and buffers are never copied; handlers may move the value out. Values
+   * larger than EVENTQUEUE_INLINE_SIZE are moved to the heap instead.
+   *
+   * Completions bypass the queue and its lanes, they are only handled by
+   * drain_completions().
+   *
+   * This method returns false if the mailbox is full, `value` is only moved
+   * from if the post succeeds.
+   */
+  template<typename T>
+  bool post(T&& value)
+  {
+    using U = std::remove_cvref_t<T>;
+    static_assert(alignof(U) <= alignof(std::max_align_t), "over-aligned event types are not supported");
+
+    auto& completions = _mailbox().completions;
+    auto completion = completions.try_reserve();
+    if (!completion) {
+      return false;
+    }
+
+    completion->id = EventTraits<U>::id();
+    if constexpr (sizeof(U) <= sizeof(completion->buffer)) {
+      new (completion->buffer) U(std::forward<T>(value));
+      completion->data = nullptr;
+      completion->destroy = [](Completion& self) { static_cast<U*>(self.payload())->~U(); };
+    } else {
+      completion->data = new U(std::forward<T>(value));
+      completion->destroy = [](Completion& self) { delete static_cast<U*>(self.data); };
+    }
+    completion->pushed = std::chrono::steady_clock::now();
+    completions.commit();
+    return true;
+  }
+
+  /**
+   * Handle the completions posted so far (see post()) on the calling thread,
+   * as one batch: mailbox by mailbox, in posting order within a mailbox.
+   *
+   * Every handler of the channel runs on the calling thread, thread-safe
+   * categories included, so this is where main-thread only work (e.g. GL
+   * uploads) belongs. Completions posted by the handlers are handled by the
+   * next call.
+   *
+   * Must only be called from the thread calling tick().
+   *
+   * This method returns the count of categories handled, like tick().
    */
-  void push_event(EventID id, void* data, size_t data_size);
+  size_t drain_completions();
+
+  /**
+   * Subscribe handler to the typed event channel of T.
+   *
+   * `fn` is any callable invocable with `T&`, it may return void or an int
+   * error code (see EventHandlerFunc). The channel is an ordinary category,
+   * created on first subscription, so the runtime id API (see channel())
+   * works on it as well.
+   *
+   * This method returns the same as register_handler().
+   */
+  template<typename T, typename F>
+  size_t subscribe(F&& fn)
+  {
+    return _subscribe(EventTraits<T>::id(), typeid(T).name(), Handler::from_callable<T>(std::forward<F>(fn)));
+  }
+
+  /**
+   * Find the channel category of T.
+   *
+   * This method returns an optional of the category id, or empty if nothing
+   * subscribed to T yet.
+   */
+  template<typename T>
+  std::optional<EventCategoryID> channel()
+  {
+    return _channel(EventTraits<T>::id());
+  }
 
   /**
    * Tick event queue, call event handlers.
    *
+   * Due timers (see push_event_at()) push their events first, then the
+   * events queued when the tick starts are taken as one batch, events
+   * pushed by the handlers (and error events) are handled in the next tick.
+   * The batch is dispatched lane by lane in EventPriority order.
+   *
+   * The time budget is checked every EVENTQUEUE_BUDGET_CHECK_INTERVAL events;
+   * events which did not fit are carried over to the next tick, in front of
+   * newly pushed events of their lane. A steady stream of higher priority
+   * events may therefore delay lower priority ones for several ticks.
+   *
+   * Handlers of thread-safe categories (see EventCategory::thread_safe) run
+   * on the worker pool. Every EVENTQUEUE_BUDGET_CHECK_INTERVAL events, the
+   * serial categories are dispatched on the calling thread first, then the
+   * thread-safe ones are fanned out to the workers, and the tick continues
+   * once all of them returned. Those handlers may therefore run concurrently
+   * with each other (also for different events of the same category, in any
+   * order) and must not modify the event data.
+   *
+   * The registry snapshot is loaded once for the whole batch and nothing is
+   * locked, so producers never wait for the handlers and handlers may change
+   * the registry; the changes take effect in the next tick.
+   *
+   * Must only be called from one thread at a time.
+   *
    * This method returns the count of events handled in this tick.
    */
   size_t tick();
   size_t tick(size_t timeout_ms);
+  size_t tick(std::chrono::microseconds budget);
+
+  /**
+   * Get payload allocation counters.
+   */
+  EventQueueAllocStats alloc_stats();
+
+  /**
+   * Get the dispatch counters of the queue and of every category.
+   *
+   * Counting is always on: it costs a clock read per pushed event, per
+   * dispatched event and per handler call, plus a few relaxed atomic adds,
+   * and never allocates. The counters of a category live as long as the
+   * category (removing a handler drops its counters).
+   *
+   * This method is thread-safe, it allocates the returned snapshot.
+   */
+  EventQueueStats stats();
+
+  /**
+   * Get the dispatch counters of one category.
+   *
+   * This method returns an optional of the counters, or empty if the
+   * category does not exist.
+   */
+  std::optional<EventCategoryStats> category_stats(EventCategoryID id);
+
+  /// Reset all dispatch counters to zero
+  void reset_stats();
+
+  /**
+   * Log the categories which spent the most time in their handlers, at most
+   * `count` of them.
+   */
+  void log_stats(size_t count = 10);
 
   /**
    * Insert category into event registry.
@@ -104,6 +808,27 @@ public:
    */
   bool remove_category(EventCategoryID id);
 
+  /**
+   * Set the coalescing function of a category (nullptr to disable).
+   *
+   * This method returns true if the change was successful, false otherwise.
+   */
+  bool set_category_coalesce(EventCategoryID id, EventCoalesceFunc coalesce);
+
+  /**
+   * Set the dispatch priority of a category.
+   *
+   * This method returns true if the change was successful, false otherwise.
+   */
+  bool set_category_priority(EventCategoryID id, EventPriority priority);
+
+  /**
+   * Mark the handlers of a category as thread-safe, see EventCategory::thread_safe.
+   *
+   * This method returns true if the change was successful, false otherwise.
+   */
+  bool set_category_thread_safe(EventCategoryID id, bool thread_safe);
+
   /**
    * Find categories by event id.
    *
@@ -118,6 +843,14 @@ public:
    */
   std::optional<EventCategoryID> find_category(std::string_view name);
 
+  /**
+   * Find the name of a category.
+   *
+   * This method returns an optional of the category name, or empty if the
+   * category does not exist.
+   */
+  std::optional<std::string> find_category_name(EventCategoryID id);
+
   /**
    * Finds the next available category id.
    *
@@ -168,11 +901,21 @@ public:
   /**
    * Return last handler from an event category, and remove it from that
    * category.
+   *
+   * Handlers added by subscribe() are no EventHandlerFunc, they are not
+   * removed (use remove_handler() for them).
+   *
+   * This method returns nullptr if there was an error.
    */
   EventHandlerFunc pop_handler(EventCategoryID id);
 
   /**
    * Return handler from an event category, and remove if from that category.
+   *
+   * Handlers added by subscribe() are no EventHandlerFunc, they are not
+   * removed (use remove_handler() for them).
+   *
+   * This method returns nullptr if there was an error.
    */
   EventHandlerFunc pop_handler(EventCategoryID id, size_t index);
 };
@@ -0,0 +1,216 @@
+#include "eventrecorder.h"
+
+#include <cstring>
+#include <limits>
+
+#include "eventqueue.h"
+#include "logger/logger.h"
+
+using namespace tedlhy::minekraf;
+
+/// size of the fixed part of a record
+static constexpr size_t record_header_size = sizeof(uint64_t) * 2 + sizeof(uint32_t);
+
+EventRecorder::EventRecorder() :
+  file(), buffer(), start(), records(0), skipped(0), skipped_ids(), active(false), mutex()
+{
+}
+
+EventRecorder::~EventRecorder()
+{
+  close();
+}
+
+bool EventRecorder::open(const std::string& path, std::set<uint64_t> skipped_ids)
+{
+  const std::lock_guard lock(mutex);
+
+  auto logger = logger::current();
+
+  if (file.is_open()) {
+    _flush_nolock();
+    file.close();
+  }
+
+  file.open(path, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    logger->error("EventRecorder::open(): could not open {} for writing", path);
+    active.store(false, std::memory_order_relaxed);
+    return false;
+  }
+
+  EventRecordHeader header{};
+  std::memcpy(header.magic, EVENTRECORD_MAGIC, sizeof(header.magic));
+  header.version = EVENTRECORD_VERSION;
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  buffer.clear();
+  buffer.reserve(buffer_size);
+  start = Clock::now();
+  records = 0;
+  skipped = 0;
+  this->skipped_ids = std::move(skipped_ids);
+  active.store(true, std::memory_order_relaxed);
+
+  logger->info("EventRecorder: recording events to {}", path);
+  return true;
+}
+
+void EventRecorder::close()
+{
+  const std::lock_guard lock(mutex);
+
+  active.store(false, std::memory_order_relaxed);
+  if (!file.is_open()) {
+    return;
+  }
+
+  _flush_nolock();
+  file.close();
+
+  auto logger = logger::current();
+  logger->info("EventRecorder: recorded {} events, skipped {} events with external data or pointers", records, skipped);
+}
+
+void EventRecorder::_flush_nolock()
+{
+  file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+  buffer.clear();
+}
+
+void EventRecorder::record(uint64_t id, const void* data, size_t data_size)
+{
+  auto time = Clock::now();
+
+  const std::lock_guard lock(mutex);
+
+  if (!active.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  if ((data && !data_size) || data_size > std::numeric_limits<uint32_t>::max() || skipped_ids.contains(id)) {
+    skipped++;
+    return;
+  }
+
+  auto offset = buffer.size();
+  buffer.resize(offset + record_header_size + data_size);
+
+  auto ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time - start).count());
+  auto size = static_cast<uint32_t>(data_size);
+  auto out = buffer.data() + offset;
+  std::memcpy(out, &ns, sizeof(ns));
+  std::memcpy(out + sizeof(ns), &id, sizeof(id));
+  std::memcpy(out + sizeof(ns) + sizeof(id), &size, sizeof(size));
+  if (data_size) {
+    std::memcpy(out + record_header_size, data, data_size);
+  }
+  records++;
+
+  if (buffer.size() >= buffer_size) {
+    _flush_nolock();
+  }
+}
+
+EventReplay::EventReplay() :
+  file(),
+  speed(1.0),
+  start(),
+  started(false),
+  pending(false),
+  pending_time(0),
+  pending_id(0),
+  pending_payload(),
+  replayed(0)
+{
+}
+
+bool EventReplay::open(const std::string& path, double speed)
+{
+  auto logger = logger::current();
+
+  file.close();
+  file.open(path, std::ios::binary);
+  if (!file) {
+    logger->error("EventReplay::open(): could not open {}", path);
+    return false;
+  }
+
+  EventRecordHeader header{};
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      std::memcmp(header.magic, EVENTRECORD_MAGIC, sizeof(header.magic)) != 0) {
+    logger->error("EventReplay::open(): {} is not an event recording", path);
+    file.close();
+    return false;
+  }
+  if (header.version != EVENTRECORD_VERSION) {
+    logger->error("EventReplay::open(): {} has version {}, expected {}", path, header.version,
+      EVENTRECORD_VERSION);
+    file.close();
+    return false;
+  }
+
+  this->speed = speed;
+  started = false;
+  replayed = 0;
+  _read_next();
+
+  logger->info("EventReplay: replaying events from {} at speed {}", path, speed);
+  return true;
+}
+
+bool EventReplay::_read_next()
+{
+  std::byte header[record_header_size];
+  pending = false;
+  if (!file.read(reinterpret_cast<char*>(header), sizeof(header))) {
+    return false;
+  }
+
+  uint32_t size;
+  std::memcpy(&pending_time, header, sizeof(pending_time));
+  std::memcpy(&pending_id, header + sizeof(pending_time), sizeof(pending_id));
+  std::memcpy(&size, header + sizeof(pending_time) + sizeof(pending_id), sizeof(size));
+
+  pending_payload.resize(size);
+  if (size && !file.read(reinterpret_cast<char*>(pending_payload.data()), size)) {
+    auto logger = logger::current();
+    logger->warning("EventReplay: recording ends with a truncated record, stopping");
+    return false;
+  }
+
+  pending = true;
+  return true;
+}
+
+bool EventReplay::pump(EventQueue& eventqueue, Clock::time_point now)
+{
+  if (!started) {
+    start = now;
+    started = true;
+  }
+
+  auto elapsed = std::chrono::duration<double, std::nano>(now - start).count();
+
+  for (size_t pushed = 0; pending; pushed++) {
+    if (speed > 0) {
+      if (static_cast<double>(pending_time) / speed > elapsed) {
+        break;
+      }
+    } else if (pushed >= batch_size) {
+      break;
+    }
+
+    auto data = pending_payload.empty() ? nullptr : pending_payload.data();
+    eventqueue.push_event(static_cast<EventID>(pending_id), data, pending_payload.size());
+    replayed++;
+    _read_next();
+  }
+
+  return pending;
+}
+
+size_t EventReplay::count() const
+{
+  return replayed;
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace tedlhy::minekraf {
+
+class EventQueue;
+
+/**
+ * Event recording file layout, all values in native byte order:
+ *
+ *   header: char magic[8] = "MKEVREC", uint32_t version, uint32_t reserved
+ *   record: uint64_t time (ns since recording start), uint64_t event id,
+ *           uint32_t payload size, payload bytes
+ *
+ * Records are appended in push order, the file is only valid on machines with
+ * the same byte order and event layouts (e.g. the same SDL version).
+ */
+struct EventRecordHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+};
+
+constexpr char EVENTRECORD_MAGIC[8] = "MKEVREC";
+constexpr uint32_t EVENTRECORD_VERSION = 1;
+
+/**
+ * Append-only binary recorder of pushed events, see EventQueue::start_recording().
+ *
+ * Records are collected in a buffer and written out in blocks, record() only
+ * touches the file once the buffer is full.
+ *
+ * All methods are thread-safe.
+ */
+class EventRecorder {
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr size_t buffer_size = 64 * 1024;
+
+  std::ofstream file;
+  std::vector<std::byte> buffer;
+  Clock::time_point start;
+  size_t records;
+  size_t skipped;
+  std::set<uint64_t> skipped_ids;  // events which can't be replayed, see open()
+
+  std::atomic<bool> active;
+  std::mutex mutex;
+
+  void _flush_nolock();
+
+public:
+  EventRecorder();
+  ~EventRecorder();
+
+  EventRecorder(const EventRecorder&) = delete;
+  EventRecorder& operator=(const EventRecorder&) = delete;
+
+  /**
+   * Start recording into the file at path, truncating it.
+   *
+   * Events with an id in `skipped_ids` are not recorded, for payloads which
+   * hold pointers (e.g. the text of SDL_TextInputEvent): only the pointer
+   * would be recorded, and it dangles on replay.
+   *
+   * This method returns false if the file could not be opened.
+   */
+  bool open(const std::string& path, std::set<uint64_t> skipped_ids = {});
+
+  /// Stop recording, flushing the buffered records
+  void close();
+
+  /// True while recording, a relaxed check for the push path
+  bool recording() const
+  {
+    return active.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Record an event pushed now.
+   *
+   * Events with external data (`data_size` = 0 but a non-null `data`) and
+   * the skipped ids passed to open() can't be replayed, they are counted as
+   * skipped instead.
+   */
+  void record(uint64_t id, const void* data, size_t data_size);
+};
+
+/**
+ * Replays a recording made by EventRecorder through EventQueue::push_event().
+ *
+ * The file is streamed, one record is read ahead.
+ */
+class EventReplay {
+  using Clock = std::chrono::steady_clock;
+
+  std::ifstream file;
+  double speed;
+  Clock::time_point start;
+  bool started;
+
+  bool pending;  // a record has been read and waits to be pushed
+  uint64_t pending_time;
+  uint64_t pending_id;
+  std::vector<std::byte> pending_payload;
+
+  size_t replayed;
+
+  bool _read_next();
+
+public:
+  /// events pushed per pump() when replaying as fast as possible
+  static constexpr size_t batch_size = 256;
+
+  EventReplay();
+
+  EventReplay(const EventReplay&) = delete;
+  EventReplay& operator=(const EventReplay&) = delete;
+
+  /**
+   * Open a recording.
+   *
+   * `speed` scales the recorded timing (2.0 replays twice as fast), pass 0 to
+   * replay as fast as possible, batch_size events per pump().
+   *
+   * This method returns false if the file could not be opened or is not a
+   * recording.
+   */
+  bool open(const std::string& path, double speed = 1.0);
+
+  /**
+   * Push the recorded events which are due at `now` onto eventqueue, the
+   * first call starts the replay clock.
+   *
+   * This method returns false once every recorded event has been pushed.
+   */
+  bool pump(EventQueue& eventqueue, Clock::time_point now);
+
+  /// Count of events pushed so far
+  size_t count() const;
+};
+
+}  // namespace tedlhy::minekraf
@@ -0,0 +1,50 @@
+#include "eventstats.h"
+
+#include <algorithm>
+
+using namespace tedlhy::minekraf;
+
+uint64_t EventHistogram::percentile(double p) const
+{
+  if (!count) {
+    return 0;
+  }
+
+  auto rank = static_cast<uint64_t>(std::clamp(p, 0.0, 1.0) * static_cast<double>(count - 1)) + 1;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets.size(); i++) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      // bucket i holds values below 2^i
+      auto limit = i ? (uint64_t{1} << i) - 1 : 0;
+      return std::min(limit, max);
+    }
+  }
+  return max;
+}
+
+AtomicHistogram::AtomicHistogram() : buckets(), count(0), sum(0), max(0)
+{
+}
+
+EventHistogram AtomicHistogram::snapshot() const
+{
+  EventHistogram histogram;
+  for (size_t i = 0; i < buckets.size(); i++) {
+    histogram.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+  }
+  histogram.count = count.load(std::memory_order_relaxed);
+  histogram.sum = sum.load(std::memory_order_relaxed);
+  histogram.max = max.load(std::memory_order_relaxed);
+  return histogram;
+}
+
+void AtomicHistogram::reset()
+{
+  for (auto& bucket : buckets) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  count.store(0, std::memory_order_relaxed);
+  sum.store(0, std::memory_order_relaxed);
+  max.store(0, std::memory_order_relaxed);
+}
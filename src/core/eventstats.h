@@ -0,0 +1,82 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+namespace tedlhy::minekraf {
+
+constexpr size_t EVENTSTATS_HISTOGRAM_BUCKETS = 32;
+
+/**
+ * Snapshot of an AtomicHistogram.
+ *
+ * Bucket 0 counts the value 0, bucket i > 0 counts values in [2^(i-1), 2^i),
+ * the last bucket also counts everything larger. Values are nanoseconds.
+ */
+struct EventHistogram {
+  std::array<uint64_t, EVENTSTATS_HISTOGRAM_BUCKETS> buckets{};
+  uint64_t count = 0;
+  uint64_t sum = 0;
+  uint64_t max = 0;
+
+  /// Bucket a value is counted in
+  static size_t bucket(uint64_t value)
+  {
+    return std::min<size_t>(std::bit_width(value), EVENTSTATS_HISTOGRAM_BUCKETS - 1);
+  }
+
+  /// Average value, 0 if nothing was recorded
+  uint64_t mean() const
+  {
+    return count ? sum / count : 0;
+  }
+
+  /**
+   * Estimate the `p`-quantile (0.99 for p99).
+   *
+   * This method returns the upper bound of the bucket holding the quantile,
+   * capped at max, so it overestimates by less than a factor of two.
+   */
+  uint64_t percentile(double p) const;
+};
+
+/**
+ * Lock-free log2 histogram, see EventHistogram.
+ *
+ * record() is a few relaxed atomic adds, it may be called from any thread
+ * and never allocates. Snapshots taken while values are recorded may be off
+ * by the values in flight.
+ */
+class AtomicHistogram {
+  std::array<std::atomic<uint64_t>, EVENTSTATS_HISTOGRAM_BUCKETS> buckets;
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> sum;
+  std::atomic<uint64_t> max;
+
+public:
+  AtomicHistogram();
+
+  AtomicHistogram(const AtomicHistogram&) = delete;
+  AtomicHistogram& operator=(const AtomicHistogram&) = delete;
+
+  void record(uint64_t value)
+  {
+    buckets[EventHistogram::bucket(value)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+
+    auto _max = max.load(std::memory_order_relaxed);
+    while (value > _max && !max.compare_exchange_weak(_max, value, std::memory_order_relaxed)) {
+    }
+  }
+
+  EventHistogram snapshot() const;
+
+  void reset();
+};
+
+}  // namespace tedlhy::minekraf
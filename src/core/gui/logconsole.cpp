@@ -0,0 +1,151 @@
+#include "logconsole.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "imgui.h"
+#include "spdlog/details/os.h"
+
+using namespace tedlhy::minekraf;
+
+static ImVec4 _level_color(spdlog::level::level_enum level)
+{
+  switch (level) {
+    case spdlog::level::trace:
+      return ImVec4(0.5f, 0.5f, 0.5f, 1.0f);
+    case spdlog::level::debug:
+      return ImVec4(0.4f, 0.7f, 1.0f, 1.0f);
+    case spdlog::level::info:
+      return ImVec4(0.4f, 0.9f, 0.4f, 1.0f);
+    case spdlog::level::warn:
+      return ImVec4(1.0f, 0.8f, 0.2f, 1.0f);
+    case spdlog::level::err:
+      return ImVec4(1.0f, 0.35f, 0.3f, 1.0f);
+    case spdlog::level::critical:
+      return ImVec4(1.0f, 0.2f, 0.6f, 1.0f);
+    default:
+      return ImVec4(1.0f, 1.0f, 1.0f, 1.0f);
+  }
+}
+
+LogConsole::LogConsole(std::shared_ptr<logger::RingBufferSink> sink) :
+  sink(std::move(sink)),
+  rows(),
+  scanned(0),
+  min_level(spdlog::level::trace),
+  hidden_categories(),
+  auto_scroll(true)
+{
+}
+
+bool LogConsole::_visible(const logger::RingBufferEntry& entry) const
+{
+  return entry.level >= min_level && !(entry.category < hidden_categories.size() && hidden_categories[entry.category]);
+}
+
+void LogConsole::_update_rows(const logger::RingBufferSink::View& view, bool refilter)
+{
+  if (refilter) {
+    rows.clear();
+    scanned = view.begin();
+  }
+
+  // entries overwritten since the last frame
+  while (!rows.empty() && rows.front() < view.begin()) {
+    rows.pop_front();
+  }
+
+  for (scanned = std::max(scanned, view.begin()); scanned < view.end(); scanned++) {
+    if (_visible(view.at(scanned))) {
+      rows.push_back(scanned);
+    }
+  }
+}
+
+void LogConsole::draw(const char* title, bool* open)
+{
+  ImGui::SetNextWindowSize(ImVec2(720, 360), ImGuiCond_FirstUseEver);
+  if (!ImGui::Begin(title, open)) {
+    ImGui::End();
+    return;
+  }
+
+  bool refilter = false;
+
+  ImGui::SetNextItemWidth(ImGui::GetFontSize() * 8);
+  if (ImGui::BeginCombo("Level", spdlog::level::to_string_view(min_level).data())) {
+    for (int level = spdlog::level::trace; level < spdlog::level::off; level++) {
+      auto _level = static_cast<spdlog::level::level_enum>(level);
+      if (ImGui::Selectable(spdlog::level::to_string_view(_level).data(), _level == min_level)) {
+        refilter |= _level != min_level;
+        min_level = _level;
+      }
+    }
+    ImGui::EndCombo();
+  }
+
+  ImGui::SameLine();
+  if (ImGui::Button("Categories")) {
+    ImGui::OpenPopup("categories");
+  }
+
+  ImGui::SameLine();
+  ImGui::Checkbox("Auto-scroll", &auto_scroll);
+
+  ImGui::SameLine();
+  if (ImGui::Button("Clear")) {
+    sink->clear();
+    rows.clear();
+  }
+
+  sink->read([&](const logger::RingBufferSink::View& view) {
+    const auto& categories = view.categories();
+    hidden_categories.resize(categories.size(), false);
+
+    if (ImGui::BeginPopup("categories")) {
+      for (size_t i = 0; i < categories.size(); i++) {
+        bool shown = !hidden_categories[i];
+        if (ImGui::Checkbox(categories[i].c_str(), &shown)) {
+          hidden_categories[i] = !shown;
+          refilter = true;
+        }
+      }
+      ImGui::EndPopup();
+    }
+
+    _update_rows(view, refilter);
+
+    ImGui::SameLine();
+    ImGui::TextDisabled("%zu / %zu", rows.size(), static_cast<size_t>(view.end() - view.begin()));
+
+    ImGui::Separator();
+    if (ImGui::BeginChild("rows", ImVec2(0, 0), ImGuiChildFlags_None, ImGuiWindowFlags_HorizontalScrollbar)) {
+      ImGuiListClipper clipper;
+      clipper.Begin(static_cast<int>(rows.size()));
+      while (clipper.Step()) {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+          const auto& entry = view.at(rows[row]);
+
+          auto time = spdlog::log_clock::to_time_t(entry.time);
+          auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(entry.time.time_since_epoch()).count();
+          auto tm = spdlog::details::os::localtime(time);
+          ImGui::TextDisabled("%02d:%02d:%02d.%03d", tm.tm_hour, tm.tm_min, tm.tm_sec, static_cast<int>(millis % 1000));
+          ImGui::SameLine();
+          ImGui::TextColored(_level_color(entry.level), "%-8s", spdlog::level::to_string_view(entry.level).data());
+          ImGui::SameLine();
+          ImGui::TextDisabled("[%s]", categories[entry.category].c_str());
+          ImGui::SameLine();
+          ImGui::TextUnformatted(entry.message.data(), entry.message.data() + entry.message.size());
+        }
+      }
+      clipper.End();
+
+      if (auto_scroll && ImGui::GetScrollY() >= ImGui::GetScrollMaxY()) {
+        ImGui::SetScrollHereY(1.0f);
+      }
+    }
+    ImGui::EndChild();
+  });
+
+  ImGui::End();
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "core/logger/ringbuffersink.h"
+
+namespace tedlhy::minekraf {
+
+/**
+ * ImGui window showing the messages of a RingBufferSink.
+ *
+ * Only the visible rows are drawn (ImGuiListClipper), and the level and
+ * category filter is applied incrementally: every frame only looks at the
+ * entries logged since the previous one, the whole buffer is only filtered
+ * again when the filter changes. The cost of a frame does not grow with the
+ * number of buffered messages.
+ */
+class LogConsole {
+  std::shared_ptr<logger::RingBufferSink> sink;
+
+  std::deque<uint64_t> rows;  // sequence numbers of the entries passing the filter, ascending
+  uint64_t scanned;  // entries before this sequence number have been filtered into rows
+
+  spdlog::level::level_enum min_level;
+  std::vector<bool> hidden_categories;  // indexed like RingBufferSink::View::categories()
+  bool auto_scroll;  // follow new messages while scrolled to the bottom
+
+  /// filter the entries logged since the last frame into rows, or all of them if `refilter`
+  void _update_rows(const logger::RingBufferSink::View& view, bool refilter);
+
+  bool _visible(const logger::RingBufferEntry& entry) const;
+
+public:
+  explicit LogConsole(std::shared_ptr<logger::RingBufferSink> sink);
+
+  /**
+   * Draw the console window, must be called between ImGui::NewFrame() and
+   * ImGui::Render(). Closing the window sets `*open` to false.
+   */
+  void draw(const char* title, bool* open = nullptr);
+};
+
+}  // namespace tedlhy::minekraf
@@ -0,0 +1,531 @@
+#include "deferred.h"
+
+#include <ctime>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+
+#include "logger.h"
+#include "spdlog/details/log_msg.h"
+#include "spdlog/details/os.h"
+#include "spdlog/sinks/sink.h"
+
+#if defined(SPDLOG_FMT_EXTERNAL)
+#include <fmt/args.h>
+#else
+#include "spdlog/fmt/bundled/args.h"
+#endif
+
+using namespace tedlhy::minekraf::logger;
+
+namespace {
+
+/// Entry types of a binary log, every entry starts with one
+enum class BinaryEntry : uint8_t {
+  format,  // uint32_t id, uint32_t size, then the characters
+  name,  // uint32_t id, uint16_t size, then the characters
+  message,  // uint32_t format id, uint32_t name id, int64_t time, uint64_t thread, uint8_t level, uint16_t size, args
+};
+
+template<typename T>
+void _put(std::ostream& out, const T& value)
+{
+  out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template<typename T>
+bool _get(std::istream& in, T& value)
+{
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+template<typename T>
+bool _get(const std::byte*& args, const std::byte* end, T& value)
+{
+  if (static_cast<size_t>(end - args) < sizeof(value)) {
+    return false;
+  }
+  std::memcpy(&value, args, sizeof(value));
+  args += sizeof(value);
+  return true;
+}
+
+bool _decode_args(fmt::dynamic_format_arg_store<fmt::format_context>& store, const std::byte* args,
+  const std::byte* end)
+{
+  while (args != end) {
+    DeferredArg tag;
+    if (!_get(args, end, tag)) {
+      return false;
+    }
+    switch (tag) {
+      case DeferredArg::i64: {
+        int64_t value;
+        if (!_get(args, end, value)) {
+          return false;
+        }
+        store.push_back(value);
+        break;
+      }
+      case DeferredArg::u64: {
+        uint64_t value;
+        if (!_get(args, end, value)) {
+          return false;
+        }
+        store.push_back(value);
+        break;
+      }
+      case DeferredArg::f32: {
+        float value;
+        if (!_get(args, end, value)) {
+          return false;
+        }
+        store.push_back(value);
+        break;
+      }
+      case DeferredArg::f64: {
+        double value;
+        if (!_get(args, end, value)) {
+          return false;
+        }
+        store.push_back(value);
+        break;
+      }
+      case DeferredArg::boolean: {
+        uint8_t value;
+        if (!_get(args, end, value)) {
+          return false;
+        }
+        store.push_back(value != 0);
+        break;
+      }
+      case DeferredArg::character: {
+        char value;
+        if (!_get(args, end, value)) {
+          return false;
+        }
+        store.push_back(value);
+        break;
+      }
+      case DeferredArg::pointer: {
+        uint64_t value;
+        if (!_get(args, end, value)) {
+          return false;
+        }
+        store.push_back(reinterpret_cast<const void*>(static_cast<uintptr_t>(value)));
+        break;
+      }
+      case DeferredArg::string: {
+        uint16_t size;
+        if (!_get(args, end, size) || static_cast<size_t>(end - args) < size) {
+          return false;
+        }
+        // the store only keeps a view, args outlive the formatting
+        store.push_back(fmt::string_view(reinterpret_cast<const char*>(args), size));
+        args += size;
+        break;
+      }
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+namespace tedlhy::minekraf::logger {
+
+std::string format_deferred(std::string_view format, const std::byte* args, size_t size)
+{
+  fmt::dynamic_format_arg_store<fmt::format_context> store;
+  if (!_decode_args(store, args, args + size)) {
+    return fmt::format("[malformed deferred record] {}", format);
+  }
+  try {
+    return fmt::vformat(fmt::string_view(format.data(), format.size()), store);
+  } catch (const std::exception& e) {
+    return fmt::format("[deferred format error: {}] {}", e.what(), format);
+  }
+}
+
+bool decode_deferred_log(std::istream& in, std::ostream& out)
+{
+  char magic[sizeof(DEFERRED_LOG_MAGIC)];
+  uint32_t version;
+  if (!_get(in, magic) || std::memcmp(magic, DEFERRED_LOG_MAGIC, sizeof(magic)) != 0 || !_get(in, version) ||
+      version != DEFERRED_LOG_VERSION) {
+    return false;
+  }
+
+  std::vector<std::string> formats;
+  std::vector<std::string> names;
+  std::string args;
+  for (;;) {
+    BinaryEntry entry;
+    if (!_get(in, entry)) {
+      return in.eof();
+    }
+
+    switch (entry) {
+      case BinaryEntry::format:
+      case BinaryEntry::name: {
+        uint32_t id;
+        uint32_t size;
+        if (entry == BinaryEntry::format) {
+          if (!_get(in, id) || !_get(in, size)) {
+            return false;
+          }
+        } else {
+          uint16_t short_size;
+          if (!_get(in, id) || !_get(in, short_size)) {
+            return false;
+          }
+          size = short_size;
+        }
+        auto& strings = entry == BinaryEntry::format ? formats : names;
+        if (id != strings.size()) {
+          return false;
+        }
+        std::string string(size, '\0');
+        if (!in.read(string.data(), size)) {
+          return false;
+        }
+        strings.push_back(std::move(string));
+        break;
+      }
+      case BinaryEntry::message: {
+        uint32_t format;
+        uint32_t name;
+        int64_t time;
+        uint64_t thread;
+        uint8_t level;
+        uint16_t size;
+        if (!_get(in, format) || !_get(in, name) || !_get(in, time) || !_get(in, thread) || !_get(in, level) ||
+            !_get(in, size) || format >= formats.size() || name >= names.size()) {
+          return false;
+        }
+        args.resize(size);
+        if (!in.read(args.data(), size)) {
+          return false;
+        }
+
+        auto seconds = static_cast<std::time_t>(time / 1'000'000'000);
+        auto micros = (time % 1'000'000'000) / 1000;
+        auto tm = spdlog::details::os::localtime(seconds);
+        auto message = format_deferred(formats[format], reinterpret_cast<const std::byte*>(args.data()), size);
+        auto level_name = level < spdlog::level::n_levels ?
+                            spdlog::level::to_string_view(static_cast<spdlog::level::level_enum>(level)) :
+                            spdlog::string_view_t("?");
+        out << fmt::format("[{:04}-{:02}-{:02} {:02}:{:02}:{:02}.{:06}] [{}] [{}] [{}] {}\n", tm.tm_year + 1900,
+          tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, micros, names[name], level_name, thread,
+          message);
+        break;
+      }
+      default:
+        return false;
+    }
+  }
+}
+
+}  // namespace tedlhy::minekraf::logger
+
+static std::atomic<uint64_t> next_instance{1};
+
+DeferredBackend::DeferredBackend(DeferredMode mode, size_t ring_capacity, bool block,
+  const std::string& binary_path, std::shared_ptr<LoggerCounters> counters) :
+  mode(mode),
+  ring_capacity(ring_capacity),
+  block(block),
+  counters(std::move(counters)),
+  instance(next_instance.fetch_add(1, std::memory_order_relaxed)),
+  rings(),
+  rings_mutex(),
+  retired_pushed(0),
+  drain_rings(),
+  file(),
+  formats(),
+  names(),
+  dropped(0),
+  stopping(false),
+  thread()
+{
+  if (mode == DeferredMode::binary) {
+    file.open(binary_path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      throw std::runtime_error(fmt::format("DeferredBackend: could not open binary log {}", binary_path));
+    }
+    file.write(DEFERRED_LOG_MAGIC, sizeof(DEFERRED_LOG_MAGIC));
+    _put(file, DEFERRED_LOG_VERSION);
+  }
+
+  thread = std::thread(&DeferredBackend::_run, this);
+}
+
+DeferredBackend::~DeferredBackend()
+{
+  stopping.store(true, std::memory_order_release);
+  thread.join();
+}
+
+DeferredBackend::Ring& DeferredBackend::_ring()
+{
+  struct RingCache {
+    uint64_t instance = 0;
+    Ring* ring = nullptr;
+    // destroyed when the thread exits, which lets the background thread retire its rings (thread ids are reused)
+    std::shared_ptr<char> alive = std::make_shared<char>();
+  };
+  // backends are few and long-lived, caching the last one is enough
+  thread_local RingCache cache;
+  if (cache.instance == instance) {
+    return *cache.ring;
+  }
+
+  const std::lock_guard lock(rings_mutex);
+  Ring* ring = nullptr;
+  for (auto& _ring : rings) {
+    if (_ring->owner.lock() == cache.alive) {
+      ring = _ring.get();
+      break;
+    }
+  }
+  if (!ring) {
+    rings.push_back(std::make_shared<Ring>(cache.alive, spdlog::details::os::thread_id(), ring_capacity));
+    ring = rings.back().get();
+  }
+  cache.instance = instance;
+  cache.ring = ring;
+  return *ring;
+}
+
+DeferredRecord* DeferredBackend::_reserve_full(Ring& ring)
+{
+  if (!block) {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  DeferredRecord* record;
+  do {
+    std::this_thread::yield();
+    record = ring.records.try_reserve();
+  } while (!record);
+  counters->count_blocked(static_cast<uint64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()));
+  return record;
+}
+
+void DeferredBackend::_run()
+{
+  for (;;) {
+    // read before draining, records pushed before stopping are drained below
+    bool stop = stopping.load(std::memory_order_acquire);
+    if (_drain() == 0) {
+      if (stop) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  if (file.is_open()) {
+    file.flush();
+  }
+}
+
+size_t DeferredBackend::_drain()
+{
+  {
+    // rings are added at the end, and only removed by this thread (from both, see below)
+    const std::lock_guard lock(rings_mutex);
+    for (size_t i = drain_rings.size(); i < rings.size(); i++) {
+      drain_rings.push_back(rings[i].get());
+    }
+  }
+
+  size_t count = 0;
+  for (size_t i = 0; i < drain_rings.size();) {
+    auto ring = drain_rings[i];
+    uint64_t ring_count = 0;
+    while (auto record = ring->records.front()) {
+      if (mode == DeferredMode::binary) {
+        _write_binary(*record, *ring);
+      } else {
+        _write(*record, *ring);
+      }
+      if (record->kind == DeferredRecordKind::heap_text) {
+        std::string* text;
+        std::memcpy(&text, record->args, sizeof(text));
+        delete text;
+      }
+      ring->records.pop();
+      ring_count++;
+    }
+    if (ring_count) {
+      if (file.is_open()) {
+        file.flush();
+      }
+      ring->written.store(ring->written.load(std::memory_order_relaxed) + ring_count, std::memory_order_release);
+      count += ring_count;
+    }
+
+    // the owner's last commit happens before its token is released, the fence makes it visible to front()
+    if (ring->owner.expired()) {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (!ring->records.front()) {
+        const std::lock_guard lock(rings_mutex);
+        retired_pushed += ring->pushed.load(std::memory_order_relaxed);
+        rings.erase(rings.begin() + static_cast<std::ptrdiff_t>(i));
+        drain_rings.erase(drain_rings.begin() + static_cast<std::ptrdiff_t>(i));
+        continue;
+      }
+    }
+    i++;
+  }
+  return count;
+}
+
+std::string_view DeferredBackend::_text(const DeferredRecord& record)
+{
+  if (record.kind == DeferredRecordKind::heap_text) {
+    const std::string* text;
+    std::memcpy(&text, record.args, sizeof(text));
+    return *text;
+  }
+  return std::string_view(reinterpret_cast<const char*>(record.args), record.size);
+}
+
+void DeferredBackend::_write(const DeferredRecord& record, const Ring& ring)
+{
+  std::string formatted;
+  std::string_view text;
+  if (record.kind == DeferredRecordKind::args) {
+    formatted = format_deferred(std::string_view(reinterpret_cast<const char*>(record.args), record.format_size),
+      record.args + record.format_size, record.size);
+    text = formatted;
+  } else {
+    text = _text(record);
+  }
+  spdlog::string_view_t message(text.data(), text.size());
+  auto level = static_cast<spdlog::level::level_enum>(record.level);
+  auto time = spdlog::log_clock::time_point(
+    std::chrono::duration_cast<spdlog::log_clock::duration>(std::chrono::nanoseconds(record.time)));
+
+  spdlog::details::log_msg msg(time, spdlog::source_loc{}, record.logger->name(), level, message);
+  msg.thread_id = ring.thread_id;
+  for (auto& sink : record.logger->sinks()) {
+    if (sink->should_log(level)) {
+      sink->log(msg);
+    }
+  }
+  if (level >= record.logger->flush_level()) {
+    for (auto& sink : record.logger->sinks()) {
+      sink->flush();
+    }
+  }
+}
+
+void DeferredBackend::_write_binary(const DeferredRecord& record, const Ring& ring)
+{
+  // formatted messages are written as the only argument of "{}"
+  static constexpr std::string_view text_format = "{}";
+  std::string_view format_string(reinterpret_cast<const char*>(record.args), record.format_size);
+  const std::byte* args = record.args + record.format_size;
+  uint16_t size = record.size;
+  std::vector<std::byte> text_args;
+  if (record.kind != DeferredRecordKind::args) {
+    // the record size is 16 bits, longer messages are cut
+    auto text = _text(record).substr(0, UINT16_MAX - sizeof(DeferredArg) - sizeof(uint16_t));
+    text_args.resize(sizeof(DeferredArg) + sizeof(uint16_t) + text.size());
+    DeferredArgWriter writer(text_args.data(), text_args.size());
+    writer.write(text);
+    format_string = text_format;
+    args = text_args.data();
+    size = static_cast<uint16_t>(text_args.size());
+  }
+
+  // formats are few, only the first record of each one allocates its key
+  auto format = formats.find(format_string);
+  if (format == formats.end()) {
+    format = formats.emplace(format_string, static_cast<uint32_t>(formats.size())).first;
+    _put(file, BinaryEntry::format);
+    _put(file, format->second);
+    _put(file, static_cast<uint32_t>(format_string.size()));
+    file.write(format_string.data(), static_cast<std::streamsize>(format_string.size()));
+  }
+
+  auto [name, new_name] = names.try_emplace(record.logger, static_cast<uint32_t>(names.size()));
+  if (new_name) {
+    const auto& logger_name = record.logger->name();
+    auto size = static_cast<uint16_t>(std::min<size_t>(logger_name.size(), UINT16_MAX));
+    _put(file, BinaryEntry::name);
+    _put(file, name->second);
+    _put(file, size);
+    file.write(logger_name.data(), size);
+  }
+
+  _put(file, BinaryEntry::message);
+  _put(file, format->second);
+  _put(file, name->second);
+  _put(file, record.time);
+  _put(file, static_cast<uint64_t>(ring.thread_id));
+  _put(file, record.level);
+  _put(file, size);
+  file.write(reinterpret_cast<const char*>(args), size);
+}
+
+void DeferredBackend::push_formatted(spdlog::logger* logger, spdlog::level::level_enum level, std::string_view text)
+{
+  auto& ring = _ring();
+  auto record = _reserve(ring);
+  if (!record) {
+    return;
+  }
+
+  if (text.size() <= sizeof(record->args)) {
+    std::memcpy(record->args, text.data(), text.size());
+    record->size = static_cast<uint16_t>(text.size());
+    record->kind = DeferredRecordKind::text;
+  } else {
+    // freed by the background thread once written
+    auto heap_text = new std::string(text);
+    std::memcpy(record->args, &heap_text, sizeof(heap_text));
+    record->size = sizeof(heap_text);
+    record->kind = DeferredRecordKind::heap_text;
+  }
+  record->format_size = 0;
+  _commit(ring, *record, logger, level);
+}
+
+void DeferredBackend::flush()
+{
+  std::vector<std::pair<std::shared_ptr<Ring>, uint64_t>> targets;
+  {
+    const std::lock_guard lock(rings_mutex);
+    for (auto& ring : rings) {
+      targets.emplace_back(ring, ring->pushed.load(std::memory_order_relaxed));
+    }
+  }
+
+  for (auto& [ring, target] : targets) {
+    while (ring->written.load(std::memory_order_acquire) < target) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+}
+
+size_t DeferredBackend::dropped_count() const
+{
+  return dropped.load(std::memory_order_relaxed);
+}
+
+uint64_t DeferredBackend::pushed_count()
+{
+  const std::lock_guard lock(rings_mutex);
+  uint64_t pushed = retired_pushed;
+  for (auto& ring : rings) {
+    pushed += ring->pushed.load(std::memory_order_relaxed);
+  }
+  return pushed;
+}
@@ -0,0 +1,330 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "core/ringbuffer.h"
+#include "spdlog/logger.h"
+
+namespace tedlhy::minekraf::logger {
+
+struct LoggerCounters;
+
+/**
+ * How Logger formats messages, see LoggerInitParams::deferred.
+ *
+ * - off: messages are formatted on the calling thread by spdlog
+ * - format: the calling thread only copies the format string and the raw
+ *   arguments, a background thread formats them into the sinks
+ * - binary: like format, but the background thread writes the raw records to
+ *   a binary file instead (see decode_deferred_log())
+ */
+enum class DeferredMode {
+  off,
+  format,
+  binary,
+};
+
+/// Argument type tags of a deferred record, every argument is a tag followed by its value
+enum class DeferredArg : uint8_t {
+  i64,  // int64_t
+  u64,  // uint64_t
+  f32,  // float, kept apart from f64 so it formats as short as a float
+  f64,  // double
+  boolean,  // uint8_t
+  character,  // char
+  pointer,  // uint64_t, formatted as const void*
+  string,  // uint16_t size, then the characters
+};
+
+/// Arguments which can be copied into a deferred record, other messages are formatted right away
+template<typename T>
+concept DeferrableArg =
+  (std::is_arithmetic_v<std::remove_cvref_t<T>> && !std::is_same_v<std::remove_cvref_t<T>, long double>) ||
+  std::is_pointer_v<std::decay_t<T>> || std::is_convertible_v<const T&, std::string_view>;
+
+constexpr size_t DEFERRED_RECORD_SIZE = 256;
+
+/// What DeferredRecord::args holds
+enum class DeferredRecordKind : uint8_t {
+  args,  // the format string, followed by its encoded arguments
+  text,  // the message formatted by the calling thread
+  heap_text,  // a std::string* owning the formatted message, too long for args
+};
+
+/// Message copied by the calling thread, one SPSCRingBuffer cell
+struct DeferredRecord {
+  spdlog::logger* logger;  // loggers of removed categories are retired, never freed while the Logger lives
+  int64_t time;  // ns since the system_clock epoch
+  uint16_t format_size;  // bytes of the format string at the start of args (DeferredRecordKind::args only)
+  uint16_t size;  // bytes used in args after the format string
+  uint8_t level;  // spdlog::level::level_enum
+  DeferredRecordKind kind;
+  std::byte args[DEFERRED_RECORD_SIZE - 2 * sizeof(uint64_t) - 2 * sizeof(uint16_t) - 2];
+};
+
+static_assert(sizeof(DeferredRecord) == DEFERRED_RECORD_SIZE);
+
+/// Binary log file magic, see decode_deferred_log()
+constexpr char DEFERRED_LOG_MAGIC[8] = "MKLOGBN";
+constexpr uint32_t DEFERRED_LOG_VERSION = 1;
+
+/// Encodes arguments into DeferredRecord::args
+class DeferredArgWriter {
+  std::byte* out;
+  std::byte* end;
+  bool fits;
+
+  void _put(const void* data, size_t size)
+  {
+    if (fits && static_cast<size_t>(end - out) >= size) {
+      std::memcpy(out, data, size);
+      out += size;
+    } else {
+      fits = false;
+    }
+  }
+
+  template<typename T>
+  void _put(DeferredArg tag, T value)
+  {
+    _put(&tag, sizeof(tag));
+    _put(&value, sizeof(value));
+  }
+
+public:
+  DeferredArgWriter(std::byte* out, size_t size) : out(out), end(out + size), fits(true) {}
+
+  template<typename T>
+  void write(const T& value)
+  {
+    using U = std::remove_cvref_t<T>;
+    if constexpr (std::is_same_v<U, bool>) {
+      _put(DeferredArg::boolean, static_cast<uint8_t>(value));
+    } else if constexpr (std::is_same_v<U, char>) {
+      _put(DeferredArg::character, value);
+    } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+      // before the pointers, const char* is a string
+      std::string_view string = value;
+      if (string.size() > UINT16_MAX) {
+        fits = false;
+        return;
+      }
+      _put(DeferredArg::string, static_cast<uint16_t>(string.size()));
+      _put(string.data(), string.size());
+    } else if constexpr (std::is_same_v<U, float>) {
+      _put(DeferredArg::f32, value);
+    } else if constexpr (std::is_floating_point_v<U>) {
+      _put(DeferredArg::f64, static_cast<double>(value));
+    } else if constexpr (std::is_signed_v<U>) {
+      _put(DeferredArg::i64, static_cast<int64_t>(value));
+    } else if constexpr (std::is_unsigned_v<U>) {
+      _put(DeferredArg::u64, static_cast<uint64_t>(value));
+    } else {
+      _put(DeferredArg::pointer, static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value)));
+    }
+  }
+
+  /// False if the arguments written so far did not fit
+  bool ok() const
+  {
+    return fits;
+  }
+
+  size_t written(const std::byte* begin) const
+  {
+    return static_cast<size_t>(out - begin);
+  }
+};
+
+/**
+ * Format a message from its format string and encoded arguments.
+ *
+ * Malformed records and format errors are formatted as an error message.
+ */
+std::string format_deferred(std::string_view format, const std::byte* args, size_t size);
+
+/**
+ * Decode a binary log written in DeferredMode::binary into text lines, one
+ * line per message:
+ *
+ *   [2025-01-31 12:34:56.789012] [category] [level] [thread id] message
+ *
+ * This function returns false if `in` is not a binary log or ends with a
+ * truncated record (the complete records are still written).
+ */
+bool decode_deferred_log(std::istream& in, std::ostream& out);
+
+/**
+ * Background half of deferred logging.
+ *
+ * Every logging thread gets its own wait-free SPSCRingBuffer of
+ * DeferredRecord cells (created on its first message), a background thread
+ * drains them into the sinks of the record's logger, or into the binary
+ * file. Messages of one thread keep their order, also the ones which can't
+ * be deferred (see push_formatted()); messages of different threads may be
+ * written out of order, they keep their own timestamps.
+ */
+class DeferredBackend {
+  /// hashes std::string keys and looks them up by std::string_view
+  struct FormatHash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view format) const
+    {
+      return std::hash<std::string_view>{}(format);
+    }
+  };
+
+  struct Ring {
+    std::weak_ptr<char> owner;  // expires once the owner thread exited, see _ring()
+    size_t thread_id;  // as printed by spdlog
+    SPSCRingBuffer<DeferredRecord> records;
+    std::atomic<uint64_t> pushed;  // records committed, only written by the owner, see flush()
+    std::atomic<uint64_t> written;  // records written out, only written by the background thread
+
+    Ring(std::weak_ptr<char> owner, size_t thread_id, size_t capacity) :
+      owner(owner), thread_id(thread_id), records(capacity), pushed(0), written(0)
+    {
+    }
+  };
+
+  DeferredMode mode;
+  size_t ring_capacity;
+  bool block;  // wait for room instead of dropping when a ring is full
+  std::shared_ptr<LoggerCounters> counters;  // of the Logger, waits for room count as blocked time
+  const uint64_t instance;  // identifies the backend in the thread-local ring cache
+
+  std::vector<std::shared_ptr<Ring>> rings;  // shared with flush(), which may wait on a ring being retired
+  std::mutex rings_mutex;  // guards rings, taken by a thread's first message and the background thread
+  uint64_t retired_pushed;  // records pushed into retired rings, guarded by rings_mutex
+  std::vector<Ring*> drain_rings;  // owned by the background thread
+
+  std::ofstream file;  // DeferredMode::binary
+  std::unordered_map<std::string, uint32_t, FormatHash, std::equal_to<>> formats;  // format strings written to file
+  std::unordered_map<spdlog::logger*, uint32_t> names;  // logger names written to file so far
+
+  std::atomic<size_t> dropped;
+  std::atomic<bool> stopping;
+  std::thread thread;
+
+  Ring& _ring();
+
+  void _run();
+
+  /// write out every committed record, returns the count
+  size_t _drain();
+
+  void _write(const DeferredRecord& record, const Ring& ring);
+
+  void _write_binary(const DeferredRecord& record, const Ring& ring);
+
+  /// the formatted message of a text record
+  static std::string_view _text(const DeferredRecord& record);
+
+  /// _reserve() of a full ring, waits for room or drops the message
+  DeferredRecord* _reserve_full(Ring& ring);
+
+  /// reserve a record in `ring`, nullptr if the ring is full and the message is dropped
+  DeferredRecord* _reserve(Ring& ring)
+  {
+    auto record = ring.records.try_reserve();
+    return record ? record : _reserve_full(ring);
+  }
+
+  /// fill in the header of a reserved record and hand it to the background thread
+  void _commit(Ring& ring, DeferredRecord& record, spdlog::logger* logger, spdlog::level::level_enum level)
+  {
+    record.logger = logger;
+    record.time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+    record.level = static_cast<uint8_t>(level);
+    ring.records.commit();
+    ring.pushed.store(ring.pushed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+public:
+  /// `binary_path` is only used in DeferredMode::binary
+  DeferredBackend(DeferredMode mode, size_t ring_capacity, bool block, const std::string& binary_path,
+    std::shared_ptr<LoggerCounters> counters);
+
+  /// writes out the remaining records
+  ~DeferredBackend();
+
+  DeferredBackend(const DeferredBackend&) = delete;
+  DeferredBackend& operator=(const DeferredBackend&) = delete;
+
+  /**
+   * Copy a message into the calling thread's ring, the format string along
+   * with the arguments (it may be a runtime string which is gone by the time
+   * the background thread formats the message).
+   *
+   * This method returns false if they don't fit into a record, the
+   * caller formats the message itself then and hands it to push_formatted().
+   * A message dropped because the ring was full counts as handled, see
+   * dropped_count().
+   *
+   * A thread's ring is freed once the thread has exited and the background
+   * thread has written out everything in it.
+   */
+  template<typename... Args>
+  bool push(spdlog::logger* logger, spdlog::level::level_enum level, std::string_view format, const Args&... args)
+  {
+    if (format.size() > sizeof(DeferredRecord::args)) {
+      return false;
+    }
+
+    auto& ring = _ring();
+    auto record = _reserve(ring);
+    if (!record) {
+      return true;
+    }
+
+    std::memcpy(record->args, format.data(), format.size());
+    auto begin = record->args + format.size();
+    DeferredArgWriter writer(begin, sizeof(record->args) - format.size());
+    (writer.write(args), ...);
+    if (!writer.ok()) {
+      // the record is not committed, push_formatted() reserves it again
+      return false;
+    }
+
+    record->format_size = static_cast<uint16_t>(format.size());
+    record->size = static_cast<uint16_t>(writer.written(begin));
+    record->kind = DeferredRecordKind::args;
+    _commit(ring, *record, logger, level);
+    return true;
+  }
+
+  /**
+   * Queue a message formatted by the calling thread, behind the messages it
+   * pushed before, for messages push() can't take. Messages longer than a
+   * record are copied to the heap.
+   */
+  void push_formatted(spdlog::logger* logger, spdlog::level::level_enum level, std::string_view text);
+
+  /// Wait until every message pushed so far (by any thread) has been written out
+  void flush();
+
+  /// Count of messages dropped because a ring was full
+  size_t dropped_count() const;
+
+  /// Count of messages pushed so far by all threads, dropped ones not included
+  uint64_t pushed_count();
+};
+
+}  // namespace tedlhy::minekraf::logger
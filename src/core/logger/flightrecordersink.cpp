@@ -0,0 +1,209 @@
+#include "flightrecordersink.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace tedlhy::minekraf::logger;
+
+// the header is padded to this, so the ring starts cache line aligned
+static constexpr uint32_t header_size = 64;
+
+static_assert(sizeof(FlightRecorderHeader) <= header_size);
+
+struct FlightRecorderSink::Mapping {
+  void* data = nullptr;
+  size_t size = 0;
+#if defined(_WIN32)
+  HANDLE file = INVALID_HANDLE_VALUE;
+  HANDLE mapping = nullptr;
+#endif
+
+  Mapping(const std::string& path, size_t size);
+  ~Mapping();
+
+  void flush();
+};
+
+#if defined(_WIN32)
+
+FlightRecorderSink::Mapping::Mapping(const std::string& path, size_t size) : size(size)
+{
+  file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+    FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error("FlightRecorderSink: could not create " + path);
+  }
+
+  mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(static_cast<uint64_t>(size) >> 32),
+    static_cast<DWORD>(size & 0xffffffff), nullptr);
+  data = mapping ? MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size) : nullptr;
+  if (!data) {
+    if (mapping) {
+      CloseHandle(mapping);
+    }
+    CloseHandle(file);
+    throw std::runtime_error("FlightRecorderSink: could not map " + path);
+  }
+}
+
+FlightRecorderSink::Mapping::~Mapping()
+{
+  FlushViewOfFile(data, 0);
+  UnmapViewOfFile(data);
+  CloseHandle(mapping);
+  CloseHandle(file);
+}
+
+void FlightRecorderSink::Mapping::flush()
+{
+  FlushViewOfFile(data, 0);
+}
+
+#else
+
+FlightRecorderSink::Mapping::Mapping(const std::string& path, size_t size) : size(size)
+{
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("FlightRecorderSink: could not create " + path);
+  }
+
+  // the pages are allocated on first write, the file is sparse until then
+  if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    ::close(fd);
+    throw std::runtime_error("FlightRecorderSink: could not resize " + path);
+  }
+
+  data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);  // the mapping keeps the file open
+  if (data == MAP_FAILED) {
+    data = nullptr;
+    throw std::runtime_error("FlightRecorderSink: could not map " + path);
+  }
+}
+
+FlightRecorderSink::Mapping::~Mapping()
+{
+  ::munmap(data, size);
+}
+
+void FlightRecorderSink::Mapping::flush()
+{
+  ::msync(data, size, MS_ASYNC);
+}
+
+#endif
+
+FlightRecorderSink::FlightRecorderSink(const std::string& path, size_t capacity) :
+  mapping(),
+  header(nullptr),
+  ring(nullptr),
+  capacity(std::max<size_t>(capacity, 1))
+{
+  // keep the recording of the previous session, it may be the one of a crash
+  std::error_code error;
+  if (std::filesystem::exists(path, error)) {
+    std::filesystem::rename(path, path + ".prev", error);
+  }
+
+  mapping = std::make_unique<Mapping>(path, header_size + this->capacity);
+  header = static_cast<FlightRecorderHeader*>(mapping->data);
+  ring = static_cast<std::byte*>(mapping->data) + header_size;
+
+  std::memcpy(header->magic, FLIGHT_RECORDER_MAGIC, sizeof(header->magic));
+  header->version = FLIGHT_RECORDER_VERSION;
+  header->header_size = header_size;
+  header->capacity = this->capacity;
+  header->head = 0;
+}
+
+FlightRecorderSink::~FlightRecorderSink()
+{
+}
+
+void FlightRecorderSink::sink_it_(const spdlog::details::log_msg& msg)
+{
+  spdlog::memory_buf_t formatted;
+  formatter_->format(msg, formatted);
+
+  // a line longer than the ring keeps its end
+  auto data = reinterpret_cast<const std::byte*>(formatted.data());
+  size_t size = formatted.size();
+  if (size > capacity) {
+    data += size - capacity;
+    size = capacity;
+  }
+
+  auto head = header->head;
+  auto pos = static_cast<size_t>(head % capacity);
+  auto first = std::min<size_t>(size, capacity - pos);
+  std::memcpy(ring + pos, data, first);
+  std::memcpy(ring, data + first, size - first);
+
+  // publish the line only once it is complete, the store must not be reordered before the copies
+  std::atomic_ref<uint64_t>(header->head).store(head + size, std::memory_order_release);
+}
+
+void FlightRecorderSink::flush_()
+{
+  mapping->flush();
+}
+
+namespace tedlhy::minekraf::logger {
+
+bool extract_flight_recording(std::istream& in, std::ostream& out)
+{
+  FlightRecorderHeader file_header;
+  if (!in.read(reinterpret_cast<char*>(&file_header), sizeof(file_header)) ||
+      std::memcmp(file_header.magic, FLIGHT_RECORDER_MAGIC, sizeof(file_header.magic)) != 0 ||
+      file_header.version != FLIGHT_RECORDER_VERSION || file_header.header_size < sizeof(file_header) ||
+      !file_header.capacity) {
+    return false;
+  }
+
+  auto used = std::min(file_header.head, file_header.capacity);
+  std::vector<char> data(static_cast<size_t>(used));
+  if (!in.seekg(file_header.header_size) || !in.read(data.data(), static_cast<std::streamsize>(used))) {
+    return false;
+  }
+
+  std::string_view text;
+  std::string unwrapped;
+  if (file_header.head <= file_header.capacity) {
+    // never wrapped, bytes after head may belong to a torn line
+    text = std::string_view(data.data(), data.size());
+  } else {
+    auto pos = static_cast<size_t>(file_header.head % file_header.capacity);
+    unwrapped.reserve(data.size());
+    unwrapped.append(data.data() + pos, data.size() - pos);
+    unwrapped.append(data.data(), pos);
+    text = unwrapped;
+
+    // the oldest line lost its start to the newest one
+    auto newline = text.find('\n');
+    text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+  }
+
+  out.write(text.data(), static_cast<std::streamsize>(text.size()));
+  return static_cast<bool>(out);
+}
+
+}  // namespace tedlhy::minekraf::logger
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "spdlog/sinks/base_sink.h"
+
+namespace tedlhy::minekraf::logger {
+
+/// Flight recording file magic, see FlightRecorderHeader
+constexpr char FLIGHT_RECORDER_MAGIC[8] = "MKFLIGH";
+constexpr uint32_t FLIGHT_RECORDER_VERSION = 1;
+
+/**
+ * Start of a flight recording file, the ring of `capacity` bytes follows at
+ * offset header_size.
+ *
+ * The ring holds formatted log lines back to back, wrapping around at its
+ * end. `head` is only advanced after a line has been copied completely, so a
+ * crash in the middle of a copy leaves at most one torn line at the head.
+ */
+struct FlightRecorderHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint64_t capacity;
+  uint64_t head;  // bytes written so far, the next line starts at head % capacity
+};
+
+/**
+ * spdlog sink writing into a fixed-size memory-mapped ring file.
+ *
+ * Logging only copies the formatted line into the shared mapping, no write
+ * syscalls; the OS writes the dirty pages back on its own, also when the
+ * process crashes (it does not protect against power loss, see flush()).
+ * Once the ring is full the oldest lines are overwritten, so the file keeps
+ * the last `capacity` bytes of the log. extract_flight_recording() (or the
+ * minekraf_flightdump tool) turns it back into a text log.
+ *
+ * An existing recording at the path is moved to "<path>.prev" first, so the
+ * recording of a crashed session survives restarting the app.
+ */
+class FlightRecorderSink final : public spdlog::sinks::base_sink<std::mutex> {
+  struct Mapping;  // platform specific
+  std::unique_ptr<Mapping> mapping;
+
+  FlightRecorderHeader* header;
+  std::byte* ring;
+  uint64_t capacity;
+
+protected:
+  void sink_it_(const spdlog::details::log_msg& msg) override;
+
+  /// ask the OS to write the dirty pages back now, without waiting for it
+  void flush_() override;
+
+public:
+  /// throws std::runtime_error if the file can't be created or mapped
+  FlightRecorderSink(const std::string& path, size_t capacity);
+  ~FlightRecorderSink() override;
+
+  FlightRecorderSink(const FlightRecorderSink&) = delete;
+  FlightRecorderSink& operator=(const FlightRecorderSink&) = delete;
+};
+
+/**
+ * Write the lines of a flight recording to `out`, oldest first.
+ *
+ * A torn line left by a crash in the middle of a write and the oldest line
+ * once the ring has wrapped (which has been partly overwritten) are skipped.
+ *
+ * This function returns false if `in` is not a flight recording.
+ */
+bool extract_flight_recording(std::istream& in, std::ostream& out);
+
+}  // namespace tedlhy::minekraf::logger
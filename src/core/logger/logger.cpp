@@ -1,12 +1,56 @@
 #include "logger.h"
 
+#include <algorithm>
+#include <chrono>
+
 #include "spdlog/async.h"
 #include "spdlog/async_logger.h"
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/sinks/basic_file_sink.h"
 
+#include "flightrecordersink.h"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 using namespace tedlhy::minekraf::logger;
 
+// discard_new and its counter are only in newer spdlog versions
+#define MINEKRAF_SPDLOG_HAS_DISCARD_NEW (SPDLOG_VERSION >= 11200)
+
+namespace {
+
+/// pin the calling thread to cpu, this function returns false if the platform refused or is not supported
+bool _pin_thread(unsigned cpu)
+{
+#if defined(_WIN32)
+  if (cpu >= sizeof(DWORD_PTR) * 8) {
+    return false;
+  }
+  return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#elif defined(__linux__)
+  if (cpu >= CPU_SETSIZE) {
+    return false;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+
+}  // namespace
+
 spdlog::level::level_enum Logger::to_spdlog_level(const LogLevel& level)
 {
   auto spdlevel = spdlog::level::off;
@@ -37,7 +81,7 @@ spdlog::level::level_enum Logger::to_spdlog_level(const LogLevel& level)
 
 std::optional<Logger::LoggerMap::iterator> Logger::_from_category_nolock(const Category& category)
 {
-  auto logger = std::make_shared<spdlog::async_logger>(category.name, sinks.begin(), sinks.end(), spdlog::thread_pool(),
+  auto logger = std::make_shared<spdlog::async_logger>(category.name, sinks.begin(), sinks.end(), thread_pool,
     initparams.policy);
   logger->set_level(to_spdlog_level(category.level));
   logger->trace("Logger (@{:p}): spdlog logger [{}] initialized", static_cast<void*>(this), logger->name());
@@ -56,25 +100,63 @@ std::optional<Logger::LoggerMap::iterator> Logger::_from_category_nolock(const C
 
 Logger::Logger(LoggerInitParams params, std::initializer_list<CategoryMap::value_type> categories,
   std::initializer_list<std::shared_ptr<spdlog::sinks::sink>> sinks) :
-  categories(categories), sinks(sinks), loggers(), _level(params.defaultlevel), initparams(std::move(params)), mutex()
+  thread_pool(),
+  counters(std::make_shared<LoggerCounters>()),
+  categories(categories),
+  sinks(sinks),
+  loggers(),
+  retired(),
+  slots(),
+  _level(params.defaultlevel),
+  initparams(std::move(params)),
+  mutex(),
+  unknown_warnings(RateLimit{.burst = 1, .period = std::chrono::seconds(10)}),
+  deferred()
 {
   // Try create default category
   this->categories.emplace(CATEGORY_NONE, Category{"app", initparams.defaultlevel});
 
+  // categories without a slot can't be logged to
+  auto dropped = std::erase_if(this->categories, [](const auto& category) { return category.first >= CATEGORY_SLOTS; });
+
   // Create default sinks
   if (this->sinks.empty()) {
     this->sinks.push_back(std::make_shared<spdlog::sinks::stdout_color_sink_mt>());
     this->sinks.push_back(std::make_shared<spdlog::sinks::basic_file_sink_mt>(initparams.filepath));
+    if (initparams.flightrecorder_size) {
+      this->sinks.push_back(
+        std::make_shared<FlightRecorderSink>(initparams.flightrecorder_filepath, initparams.flightrecorder_size));
+    }
   }
 
-  // init thread pool if it isn't already
-  if (!spdlog::thread_pool()) {
-    spdlog::init_thread_pool(8192, 1);
+  // every Logger gets its own thread pool, sized by its params
+  auto next_worker = std::make_shared<std::atomic<size_t>>(0);
+  thread_pool = std::make_shared<spdlog::details::thread_pool>(std::max<size_t>(initparams.queue_size, 1),
+    std::max<size_t>(initparams.worker_count, 1), [cpus = initparams.worker_cpus, next_worker, counters = counters] {
+      if (cpus.empty()) {
+        return;
+      }
+      // workers start on their own threads, possibly after the constructor returned
+      auto worker = next_worker->fetch_add(1, std::memory_order_relaxed);
+      if (!_pin_thread(cpus[worker % cpus.size()])) {
+        counters->pin_failures.fetch_add(1, std::memory_order_relaxed);
+      }
+    });
+
+  if (initparams.deferred != DeferredMode::off) {
+    deferred = std::make_unique<DeferredBackend>(initparams.deferred, initparams.deferred_capacity,
+      initparams.policy == spdlog::async_overflow_policy::block, initparams.deferred_filepath, counters);
   }
 
   // Create loggers for categories
-  for (const auto& [_, category] : this->categories) {
+  for (const auto& [idx, category] : this->categories) {
     _from_category_nolock(category);
+    _publish_slot_nolock(idx);
+  }
+
+  if (dropped) {
+    warning("Logger (@{:p}): ignored {} categories with an index not below {}", static_cast<void*>(this), dropped,
+      CATEGORY_SLOTS);
   }
 
   trace("Logger::Logger() @{:p}", static_cast<void*>(this));
@@ -83,30 +165,157 @@ Logger::Logger(LoggerInitParams params, std::initializer_list<CategoryMap::value
 Logger::~Logger()
 {
   trace("Logger::~Logger() @{:p}", static_cast<void*>(this));
+
+  // stop being the default, current() must not hand out a dangling pointer
+  Logger* self = this;
+  _current.compare_exchange_strong(self, nullptr, std::memory_order_acq_rel);
+
+  if (deferred) {
+    if (auto dropped = deferred->dropped_count()) {
+      if (auto _logger = slots[CATEGORY_NONE].logger.load(std::memory_order_relaxed)) {
+        _logger->warn("Logger (@{:p}): dropped {} deferred messages, rings were full", static_cast<void*>(this),
+          dropped);
+      }
+    }
+    // writes out the remaining messages while the loggers are still alive
+    deferred.reset();
+  }
+}
+
+void Logger::flush()
+{
+  if (deferred) {
+    deferred->flush();
+  }
+}
+
+void LoggerCounters::count_blocked(uint64_t blocked)
+{
+  blocked_time.fetch_add(blocked, std::memory_order_relaxed);
+  auto _max_blocked = max_blocked.load(std::memory_order_relaxed);
+  while (blocked > _max_blocked &&
+         !max_blocked.compare_exchange_weak(_max_blocked, blocked, std::memory_order_relaxed)) {
+  }
+}
+
+bool Logger::_admit(RateLimiter& limiter, spdlog::logger* _logger, const LogLevel level)
+{
+  uint64_t dropped;
+  if (!limiter.admit(dropped)) {
+    counters->suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  // the summary takes the same path as the message, so it is not reordered with it
+  if (dropped) {
+    _log_to(_logger, level, "suppressed {} messages (rate limit)", dropped);
+  }
+  return true;
+}
+
+LoggerStats Logger::stats() const
+{
+  return LoggerStats{
+    .enqueued = counters->enqueued.load(std::memory_order_relaxed) +
+                (deferred ? deferred->pushed_count() - counters->deferred_base.load(std::memory_order_relaxed) : 0),
+    .overrun = thread_pool->overrun_counter() - counters->overrun_base.load(std::memory_order_relaxed),
+#if MINEKRAF_SPDLOG_HAS_DISCARD_NEW
+    .discarded = thread_pool->discard_counter() - counters->discarded_base.load(std::memory_order_relaxed),
+#else
+    .discarded = 0,
+#endif
+    .deferred_dropped = deferred ? deferred->dropped_count() : 0,
+    .blocked_time = counters->blocked_time.load(std::memory_order_relaxed),
+    .max_blocked = counters->max_blocked.load(std::memory_order_relaxed),
+    .queue_depth = thread_pool->queue_size(),
+    .pin_failures = counters->pin_failures.load(std::memory_order_relaxed),
+    .suppressed = counters->suppressed.load(std::memory_order_relaxed),
+  };
+}
+
+void Logger::reset_stats()
+{
+  counters->enqueued.store(0, std::memory_order_relaxed);
+  counters->blocked_time.store(0, std::memory_order_relaxed);
+  counters->max_blocked.store(0, std::memory_order_relaxed);
+  counters->suppressed.store(0, std::memory_order_relaxed);
+  // not every spdlog version can reset the pool's counters, remember where they were instead
+  counters->overrun_base.store(thread_pool->overrun_counter(), std::memory_order_relaxed);
+  if (deferred) {
+    // deferred pushes are counted by their threads' rings
+    counters->deferred_base.store(deferred->pushed_count(), std::memory_order_relaxed);
+  }
+#if MINEKRAF_SPDLOG_HAS_DISCARD_NEW
+  counters->discarded_base.store(thread_pool->discard_counter(), std::memory_order_relaxed);
+#endif
+}
+
+void Logger::log_stats()
+{
+  auto logger_stats = stats();
+  info("Logger (@{:p}): {} messages queued, {} overrun, {} discarded, {} deferred dropped, {} suppressed, "
+       "blocked {}us (max {}us), queue {}/{}",
+    static_cast<void*>(this), logger_stats.enqueued, logger_stats.overrun, logger_stats.discarded,
+    logger_stats.deferred_dropped, logger_stats.suppressed, logger_stats.blocked_time / 1000,
+    logger_stats.max_blocked / 1000, logger_stats.queue_depth, initparams.queue_size);
+  if (logger_stats.pin_failures) {
+    warning("Logger (@{:p}): could not pin {} thread pool workers to their CPUs", static_cast<void*>(this),
+      logger_stats.pin_failures);
+  }
+}
+
+void Logger::_publish_slot_nolock(CategoryKeyT idx)
+{
+  auto& slot = slots[idx];
+
+  auto _category = categories.find(idx);
+  auto _logger = _category != categories.end() ? loggers.find(_category->second.name) : loggers.end();
+  if (_logger == loggers.end()) {
+    slot.logger.store(nullptr, std::memory_order_release);
+    slot.level.store(LogLevel::trace, std::memory_order_relaxed);
+    slot.limiter.set({});
+    return;
+  }
+
+  slot.limiter.set(_category->second.limit);
+
+  // both the default level and the category level filter, fold them into one compare
+  LogLevel::LogLevelEnum level = _category->second.level;
+  slot.level.store(std::max(level, _level.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+  slot.logger.store(_logger->second.get(), std::memory_order_release);
 }
 
 void Logger::level(const LogLevel& level)
 {
   const std::lock_guard lock(mutex);
   trace("Logger (@{:p}): Setting logger level to: {}", static_cast<void*>(this), level);
-  _level = level;
+  _level.store(level, std::memory_order_relaxed);
+  for (const auto& [idx, _] : categories) {
+    _publish_slot_nolock(idx);
+  }
 }
 
-const LogLevel& Logger::level() const
+LogLevel Logger::level() const
 {
-  return _level;
+  return _level.load(std::memory_order_relaxed);
 }
 
 bool Logger::insert_category(CategoryKeyT idx, Category&& category)
 {
   const std::lock_guard lock(mutex);
 
+  if (idx >= CATEGORY_SLOTS) {
+    return false;
+  }
+
   auto [_category, success] = categories.emplace(idx, std::move(category));
   if (success) {
     // create logger for the category
     if (!_from_category_nolock(_category->second)) {
+      categories.erase(_category);
       return false;
     }
+    _publish_slot_nolock(idx);
   }
   return success;
 }
@@ -125,13 +334,16 @@ bool Logger::remove_category(CategoryKeyT idx)
     return false;
   }
 
-  // try to remove logger as well
+  // try to remove logger as well, log() may still be using it
   if (auto _logger = loggers.find(_category->second.name); _logger != loggers.end()) {
     _logger->second->debug("Logger (@{:p}): removing spdlog logger [{}]", static_cast<void*>(this), _logger->first);
+    retired.push_back(std::move(_logger->second));
     loggers.erase(_logger);
   }
 
-  return categories.erase(idx);
+  categories.erase(_category);
+  _publish_slot_nolock(idx);
+  return true;
 }
 
 bool Logger::set_category_level(CategoryKeyT idx, const LogLevel& level)
@@ -146,6 +358,22 @@ bool Logger::set_category_level(CategoryKeyT idx, const LogLevel& level)
   auto& category = _category->second;
   category.level = level;
   loggers.at(category.name)->set_level(to_spdlog_level(level));
+  _publish_slot_nolock(idx);
+
+  return true;
+}
+
+bool Logger::set_category_limit(CategoryKeyT idx, const RateLimit& limit)
+{
+  const std::lock_guard lock(mutex);
+
+  auto _category = categories.find(idx);
+  if (_category == categories.end()) {
+    return false;
+  }
+
+  _category->second.limit = limit;
+  _publish_slot_nolock(idx);
 
   return true;
 }
@@ -184,25 +412,41 @@ size_t Logger::remove_sink(size_t idx)
 
 namespace tedlhy::minekraf::logger {
 
+std::atomic<Logger*> _current{nullptr};
+
 static std::weak_ptr<Logger> _global;
+static std::vector<std::shared_ptr<Logger>> _replaced;  // see set()
+static std::mutex _global_mutex;  // guards _global and _replaced
+
+static void _set_nolock(std::shared_ptr<Logger> logger)
+{
+  if (auto previous = _global.lock(); previous && previous != logger) {
+    _replaced.push_back(std::move(previous));
+  }
+  _global = logger;
+  _current.store(logger.get(), std::memory_order_release);
+}
 
 std::shared_ptr<Logger> init_default(LoggerInitParams param)
 {
   static std::shared_ptr<Logger> _default;
-  if (!_global.expired()) {
+  const std::lock_guard lock(_global_mutex);
+  if (_global.expired()) {
     _default = std::make_shared<Logger>(param);
-    _global = _default;
+    _set_nolock(_default);
   }
   return _global.lock();
 }
 
 void set(std::shared_ptr<Logger> logger)
 {
-  _global = logger;
+  const std::lock_guard lock(_global_mutex);
+  _set_nolock(std::move(logger));
 }
 
 std::shared_ptr<Logger> get()
 {
+  const std::lock_guard lock(_global_mutex);
   assert(!_global.expired() && "Default logger is not initialized! Did you forget to call init_default()?");
 
   return _global.lock();
@@ -1,17 +1,65 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
 #include <format>
+#include <iterator>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
 #include <vector>
 
+#include "deferred.h"
 #include "loglevel.h"
+#include "ratelimit.h"
 #include "spdlog/async.h"
 #include "spdlog/async_logger.h"
 #include "spdlog/logger.h"
 
+/**
+ * Log through `target` (anything dereferencing to a Logger, e.g. the result of
+ * logger::current()) only if the level is compiled in (see ACTIVE_LEVEL) and not
+ * filtered at runtime; otherwise neither `target` nor the message arguments
+ * are evaluated:
+ *
+ *   MINEKRAF_LOG_TRACE(logger::current(), "pushed {}", expensive());
+ */
+#define MINEKRAF_LOG_AT(target, lvl, ...)                                              \
+  do {                                                                                 \
+    using _minekraf_LogLevel = ::tedlhy::minekraf::logger::LogLevel;                   \
+    if constexpr (::tedlhy::minekraf::logger::level_active(_minekraf_LogLevel::lvl)) { \
+      auto&& _minekraf_logger = (target);                                              \
+      if (_minekraf_logger->should_log(_minekraf_LogLevel::lvl)) {                     \
+        _minekraf_logger->lvl(__VA_ARGS__);                                            \
+      }                                                                                \
+    }                                                                                  \
+  } while (0)
+
+#define MINEKRAF_LOG_TRACE(target, ...) MINEKRAF_LOG_AT(target, trace, __VA_ARGS__)
+#define MINEKRAF_LOG_DEBUG(target, ...) MINEKRAF_LOG_AT(target, debug, __VA_ARGS__)
+
+/**
+ * MINEKRAF_LOG_AT() through a RateLimiter, e.g. one per call site logging
+ * every frame or event (see Logger::log_limited()):
+ *
+ *   static logger::RateLimiter limiter({.burst = 10, .period = std::chrono::seconds(1)});
+ *   MINEKRAF_LOG_LIMITED(logger::current(), limiter, trace, "frame {}", frame);
+ */
+#define MINEKRAF_LOG_LIMITED(target, limiter, lvl, ...)                                 \
+  do {                                                                                  \
+    using _minekraf_LogLevel = ::tedlhy::minekraf::logger::LogLevel;                    \
+    if constexpr (::tedlhy::minekraf::logger::level_active(_minekraf_LogLevel::lvl)) {  \
+      auto&& _minekraf_logger = (target);                                               \
+      if (_minekraf_logger->should_log(_minekraf_LogLevel::lvl)) {                      \
+        _minekraf_logger->log_limited((limiter), _minekraf_LogLevel::lvl, __VA_ARGS__); \
+      }                                                                                 \
+    }                                                                                   \
+  } while (0)
+
 namespace tedlhy::minekraf::logger {
 
 template<typename... Args>
@@ -20,6 +68,7 @@ using format_string_t = spdlog::format_string_t<Args...>;
 struct Category {
   std::string name;
   LogLevel level;
+  RateLimit limit = {};  // applied to the messages passing the level, see RateLimiter
 };
 
 using CategoryMap = std::map<unsigned, Category>;
@@ -28,31 +77,207 @@ using CategoryValT = CategoryMap::value_type;
 
 static constexpr CategoryKeyT CATEGORY_NONE = 0;
 
+/// Category keys must be below this, see Logger::insert_category()
+static constexpr CategoryKeyT CATEGORY_SLOTS = 256;
+
 struct LoggerInitParams {
   LogLevel defaultlevel = LogLevel::info;
   std::string filepath = "log.txt";
+  /**
+   * What a log call does when the queue of the thread pool is full: block
+   * waits for room (so a slow sink can stall the caller, see
+   * LoggerStats::blocked_time), the others drop a message.
+   */
   spdlog::async_overflow_policy policy = spdlog::async_overflow_policy::block;
+  size_t queue_size = 8192;  // messages waiting for the thread pool's workers
+  size_t worker_count = 1;  // threads writing to the sinks, more than one may reorder messages
+  std::vector<unsigned> worker_cpus = {};  // pin worker i to CPU worker_cpus[i % size] (best effort), empty: don't pin
+  /**
+   * Defer formatting to a background thread (or a decoder, see
+   * DeferredMode), messages with arguments which can't be deferred are still
+   * formatted on the calling thread. The policy also applies to the per-thread
+   * rings: block waits for room, the others drop the new message.
+   */
+  DeferredMode deferred = DeferredMode::off;
+  /**
+   * Messages per logging thread, every thread which logs gets a ring of this
+   * many 256 byte records (256 KiB by default), freed after the thread exits.
+   */
+  size_t deferred_capacity = 1024;
+  std::string deferred_filepath = "log.bin";  // DeferredMode::binary
+  /**
+   * Size in bytes of a memory-mapped ring file added to the default sinks,
+   * which keeps the end of the log when the process crashes, see
+   * FlightRecorderSink. 0: don't add one.
+   */
+  size_t flightrecorder_size = 0;
+  std::string flightrecorder_filepath = "log.flight";
+};
+
+/// Counters of a Logger's thread pool queue, see Logger::stats()
+struct LoggerStats {
+  uint64_t enqueued = 0;  // messages pushed into the queue, or into a deferred ring
+  uint64_t overrun = 0;  // queued messages dropped for newer ones (overrun_oldest)
+  uint64_t discarded = 0;  // new messages dropped because the queue was full (discard_new)
+  uint64_t deferred_dropped = 0;  // messages dropped because a deferred ring was full
+  uint64_t blocked_time = 0;  // ns log calls spent waiting for room in a full queue or deferred ring (block only)
+  uint64_t max_blocked = 0;  // longest of these waits in ns (block only)
+  uint64_t queue_depth = 0;  // messages waiting right now
+  uint64_t pin_failures = 0;  // workers which could not be pinned to their LoggerInitParams::worker_cpus
+  uint64_t suppressed = 0;  // messages dropped by rate limits, see RateLimiter
+};
+
+/// Counters of a Logger, shared with its thread pool workers, see LoggerStats
+struct LoggerCounters {
+  std::atomic<uint64_t> enqueued{0};
+  std::atomic<uint64_t> blocked_time{0};
+  std::atomic<uint64_t> max_blocked{0};
+  std::atomic<uint64_t> pin_failures{0};
+  std::atomic<uint64_t> suppressed{0};
+  std::atomic<uint64_t> overrun_base{0};  // thread pool counters at the last reset_stats()
+  std::atomic<uint64_t> discarded_base{0};
+  std::atomic<uint64_t> deferred_base{0};  // DeferredBackend::pushed_count() at the last reset_stats()
+
+  /// add a wait for room of `blocked` ns to blocked_time and max_blocked
+  void count_blocked(uint64_t blocked);
 };
 
 class Logger {
   using SinkVector = std::vector<spdlog::sink_ptr>;
   using LoggerMap = std::map<std::string, std::shared_ptr<spdlog::logger>>;
 
+  /**
+   * Lock-free view of one category for log(), indexed by category key.
+   *
+   * Slots are only written under mutex; loggers of removed categories are
+   * retired instead of destroyed, so a pointer loaded by log() stays valid.
+   */
+  struct CategorySlot {
+    std::atomic<LogLevel::LogLevelEnum> level{LogLevel::trace};  // max(category level, default level)
+    std::atomic<spdlog::logger*> logger{nullptr};  // nullptr: no such category, log() falls back to the default
+    RateLimiter limiter;  // Category::limit
+  };
+
+  std::shared_ptr<spdlog::details::thread_pool> thread_pool;  // before the loggers, they only keep a weak_ptr
+  std::shared_ptr<LoggerCounters> counters;
+
   CategoryMap categories;
   SinkVector sinks;
   LoggerMap loggers;
+  std::vector<std::shared_ptr<spdlog::logger>> retired;  // loggers of removed categories, see CategorySlot
+  std::array<CategorySlot, CATEGORY_SLOTS> slots;
 
-  LogLevel _level;
+  std::atomic<LogLevel::LogLevelEnum> _level;
   LoggerInitParams initparams;
 
-  std::mutex mutex;
+  std::mutex mutex;  // serializes changes to the categories, loggers and sinks
+
+  RateLimiter unknown_warnings;  // log() of a category which does not exist warns this often
 
-  CategoryKeyT last_category = CATEGORY_NONE;  // for log() warning spam avoidance
+  std::unique_ptr<DeferredBackend> deferred;  // set once in the constructor, nullptr if DeferredMode::off
 
   static spdlog::level::level_enum to_spdlog_level(const LogLevel& level);
 
   std::optional<LoggerMap::iterator> _from_category_nolock(const Category& category);
 
+  /// update the slot of category idx after the category, its logger or the level changed
+  void _publish_slot_nolock(CategoryKeyT idx);
+
+  /**
+   * Take a token from `limiter` for a message, logging a summary of the
+   * messages suppressed before it.
+   *
+   * This method returns false if the message is suppressed.
+   */
+  bool _admit(RateLimiter& limiter, spdlog::logger* _logger, const LogLevel level);
+
+  /// format a message into `formatted`, a format error is formatted as an error message
+  template<typename... Args>
+  static void _format(spdlog::memory_buf_t& formatted, format_string_t<Args...> fmt, Args&&... args)
+  {
+    try {
+      spdlog::fmt_lib::format_to(std::back_inserter(formatted), fmt, std::forward<Args>(args)...);
+    } catch (const std::exception& e) {
+      formatted.clear();
+      spdlog::fmt_lib::format_to(std::back_inserter(formatted), "[format error: {}]", e.what());
+    }
+  }
+
+  /**
+   * Hand a message to an spdlog logger, which formats it and pushes it into
+   * the thread pool queue, counting it (and timing the wait for room if the
+   * queue is full and blocks).
+   */
+  template<typename... Args>
+  void _log_queued(spdlog::logger* _logger, const LogLevel level, format_string_t<Args...> fmt, Args&&... args)
+  {
+    // the queue push takes a mutex shared by all loggers anyway, one more shared counter is noise
+    counters->enqueued.fetch_add(1, std::memory_order_relaxed);
+    if (initparams.policy != spdlog::async_overflow_policy::block ||
+        thread_pool->queue_size() < initparams.queue_size) {
+      // only a full queue makes block wait, timing the others is not worth two clock reads (a queue filling up
+      // between the check and the push goes untimed)
+      _logger->log(to_spdlog_level(level), fmt, std::forward<Args>(args)...);
+      return;
+    }
+
+    // format first, only the push waits for room
+    spdlog::memory_buf_t formatted;
+    _format(formatted, fmt, std::forward<Args>(args)...);
+    auto start = std::chrono::steady_clock::now();
+    _logger->log(to_spdlog_level(level), spdlog::string_view_t(formatted.data(), formatted.size()));
+    counters->count_blocked(static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()));
+  }
+
+  /**
+   * Log through the deferred backend if it is on, through the queue
+   * otherwise. Messages the backend can't defer are formatted here and still
+   * go through the calling thread's ring, so they stay in order with its
+   * deferred messages.
+   */
+  template<typename... Args>
+  void _log_to(spdlog::logger* _logger, const LogLevel level, format_string_t<Args...> fmt, Args&&... args)
+  {
+    if (!deferred) {
+      _log_queued(_logger, level, fmt, std::forward<Args>(args)...);
+      return;
+    }
+
+    if constexpr ((DeferrableArg<Args> && ...)) {
+      spdlog::string_view_t format = fmt;
+      if (deferred->push(_logger, to_spdlog_level(level), std::string_view(format.data(), format.size()), args...)) {
+        return;
+      }
+    }
+
+    spdlog::memory_buf_t formatted;
+    _format(formatted, fmt, std::forward<Args>(args)...);
+    deferred->push_formatted(_logger, to_spdlog_level(level), std::string_view(formatted.data(), formatted.size()));
+  }
+
+  /// log() of a category without a slot, logs with the default category
+  template<typename... Args>
+  void _log_unknown(const CategoryKeyT category, const LogLevel level, format_string_t<Args...> fmt, Args&&... args)
+  {
+    auto& def_slot = slots[CATEGORY_NONE];
+    if (level < def_slot.level.load(std::memory_order_relaxed)) {
+      return;
+    }
+
+    // the default category can't be removed, its slot is always set
+    auto def_logger = def_slot.logger.load(std::memory_order_acquire);
+
+    uint64_t dropped;
+    if (LogLevel::warning >= def_slot.level.load(std::memory_order_relaxed) && unknown_warnings.admit(dropped)) {
+      _log_to(def_logger, LogLevel::warning,
+        "Logger (@{:p}): Logging category with index {} does not exist ({} more warnings suppressed)",
+        static_cast<void*>(this), category, dropped);
+    }
+
+    _log_to(def_logger, level, fmt, std::forward<Args>(args)...);
+  }
+
 public:
   Logger(LoggerInitParams params, std::initializer_list<CategoryMap::value_type> categories = {},
     std::initializer_list<std::shared_ptr<spdlog::sinks::sink>> sinks = {});
@@ -62,12 +287,14 @@ public:
   void level(const LogLevel& level);
 
   /// Get logging level
-  const LogLevel& level() const;
+  LogLevel level() const;
 
   /**
    * Insert Category into categories map.
    *
-   * This method returns true if insertion was successful, false otherwise.
+   * This method returns true if insertion was successful, false otherwise
+   * (also if idx is not below CATEGORY_SLOTS, or a category with the same
+   * name exists).
    */
   bool insert_category(CategoryKeyT idx, Category&& category);
 
@@ -105,40 +332,39 @@ public:
    */
   size_t remove_sink(size_t idx);
 
+  /**
+   * Log a message with a category.
+   *
+   * Lock-free and safe against concurrent category changes: filtered
+   * messages cost one atomic load and compare. With LoggerInitParams::deferred
+   * the message is only copied, see DeferredBackend::push(). Messages passing
+   * the level go through the category's rate limit, see Category::limit.
+   */
   template<typename... Args>
   inline void log(const CategoryKeyT category, const LogLevel level, format_string_t<Args...> fmt, Args&&... args)
   {
-    if (level < _level) {
+    if (category >= slots.size()) {
+      _log_unknown(category, level, fmt, std::forward<Args>(args)...);
       return;
     }
 
-    auto spdloglevel = to_spdlog_level(level);
-
-    auto _category = categories.find(category);
-    if (_category == categories.end()) {
-      // this deliberately throws an exception when the default logger/category doesn't exist (because they should)
-      auto& def_category = categories.at(CATEGORY_NONE);
-      auto& def_logger = loggers.at(def_category.name);
-
-      // check last warned category, eliminates most warning spam
-      if (category != last_category) {
-        def_logger->warn("Logger (@{:p}): Logging category with index {} does not exist", static_cast<void*>(this),
-          category);
-        last_category = category;
-      }
+    auto& slot = slots[category];
+    if (level < slot.level.load(std::memory_order_relaxed)) {
+      return;
+    }
 
-      // log the message with the default category
-      def_logger->log(spdloglevel, fmt, std::forward<Args>(args)...);
+    auto _logger = slot.logger.load(std::memory_order_acquire);
+    if (!_logger) {
+      // empty slots let every level through to end up here
+      _log_unknown(category, level, fmt, std::forward<Args>(args)...);
       return;
     }
 
-    auto _logger = loggers.find(_category->second.name);
-    if (_logger == loggers.end()) {
-      throw std::runtime_error(fmt::format("Logger (@{:p}): spdlog logger [{}] was not found, but it's category was",
-        static_cast<void*>(this), _category->second.name));
+    if (slot.limiter.limited() && !_admit(slot.limiter, _logger, level)) {
+      return;
     }
 
-    _logger->second->log(spdloglevel, fmt, std::forward<Args>(args)...);
+    _log_to(_logger, level, fmt, std::forward<Args>(args)...);
   }
 
   template<typename... Args>
@@ -159,148 +385,217 @@ public:
     log(CATEGORY_NONE, level, "{}", msg);
   }
 
+  /**
+   * Log with a level known at compile time, compiles to nothing if `Level` is
+   * below ACTIVE_LEVEL (the arguments are still evaluated, see
+   * MINEKRAF_LOG_TRACE() for hot paths).
+   */
+  template<LogLevel::LogLevelEnum Level, typename... Args>
+  inline void log(const CategoryKeyT category, format_string_t<Args...> fmt, Args&&... args)
+  {
+    if constexpr (level_active(Level)) {
+      log(category, Level, fmt, std::forward<Args>(args)...);
+    }
+  }
+
+  /**
+   * Log a message if `limiter` lets it through, e.g. a limiter per call site
+   * (see MINEKRAF_LOG_LIMITED()). The category's own limit applies too.
+   *
+   * Messages filtered by their level do not take a token.
+   */
+  template<typename... Args>
+  void log_limited(RateLimiter& limiter, const CategoryKeyT category, const LogLevel level,
+    format_string_t<Args...> fmt, Args&&... args)
+  {
+    // categories without a slot log with the default category, and its level
+    auto _logger = category < slots.size() ? slots[category].logger.load(std::memory_order_acquire) : nullptr;
+    auto& slot = _logger ? slots[category] : slots[CATEGORY_NONE];
+    if (level < slot.level.load(std::memory_order_relaxed)) {
+      return;
+    }
+
+    if (!_admit(limiter, _logger ? _logger : slot.logger.load(std::memory_order_acquire), level)) {
+      return;
+    }
+
+    log(category, level, fmt, std::forward<Args>(args)...);
+  }
+
+  template<typename... Args>
+  void log_limited(RateLimiter& limiter, const LogLevel level, format_string_t<Args...> fmt, Args&&... args)
+  {
+    log_limited(limiter, CATEGORY_NONE, level, fmt, std::forward<Args>(args)...);
+  }
+
+  /**
+   * Set Category's rate limit.
+   *
+   * This method returns true if change was successful, false if category was
+   * not found.
+   */
+  bool set_category_limit(CategoryKeyT idx, const RateLimit& limit);
+
+  /// Wait until deferred messages logged so far are written out (no-op if DeferredMode::off)
+  void flush();
+
+  /// Snapshot of the thread pool queue counters
+  LoggerStats stats() const;
+
+  /// Reset the counters of stats(), e.g. after loading a level
+  void reset_stats();
+
+  /// Log a summary of stats() at info level
+  void log_stats();
+
+  /// True if a message of level would be logged (by the default category)
+  bool should_log(const LogLevel& level) const
+  {
+    return level_active(level) && !(level < slots[CATEGORY_NONE].level.load(std::memory_order_relaxed));
+  }
+
   template<typename... Args>
   inline void trace(const CategoryKeyT category, format_string_t<Args...> fmt, Args&&... args)
   {
-    log(category, LogLevel::trace, fmt, std::forward<Args>(args)...);
+    log<LogLevel::trace>(category, fmt, std::forward<Args>(args)...);
   }
 
   template<typename... Args>
   inline void trace(format_string_t<Args...> fmt, Args&&... args)
   {
-    log(CATEGORY_NONE, LogLevel::trace, fmt, std::forward<Args>(args)...);
+    log<LogLevel::trace>(CATEGORY_NONE, fmt, std::forward<Args>(args)...);
   }
 
   template<typename T>
   void trace(const CategoryKeyT category, const T& msg)
   {
-    log(category, LogLevel::trace, "{}", msg);
+    log<LogLevel::trace>(category, "{}", msg);
   }
 
   template<typename T>
   void trace(const T& msg)
   {
-    log(CATEGORY_NONE, LogLevel::trace, "{}", msg);
+    log<LogLevel::trace>(CATEGORY_NONE, "{}", msg);
   }
 
   template<typename... Args>
   inline void debug(const CategoryKeyT category, format_string_t<Args...> fmt, Args&&... args)
   {
-    log(category, LogLevel::debug, fmt, std::forward<Args>(args)...);
+    log<LogLevel::debug>(category, fmt, std::forward<Args>(args)...);
   }
 
   template<typename... Args>
   inline void debug(format_string_t<Args...> fmt, Args&&... args)
   {
-    log(CATEGORY_NONE, LogLevel::debug, fmt, std::forward<Args>(args)...);
+    log<LogLevel::debug>(CATEGORY_NONE, fmt, std::forward<Args>(args)...);
   }
 
   template<typename T>
   void debug(const CategoryKeyT category, const T& msg)
   {
-    log(category, LogLevel::debug, "{}", msg);
+    log<LogLevel::debug>(category, "{}", msg);
   }
 
   template<typename T>
   void debug(const T& msg)
   {
-    log(CATEGORY_NONE, LogLevel::debug, "{}", msg);
+    log<LogLevel::debug>(CATEGORY_NONE, "{}", msg);
   }
 
   template<typename... Args>
   inline void info(const CategoryKeyT category, format_string_t<Args...> fmt, Args&&... args)
   {
-    log(category, LogLevel::info, fmt, std::forward<Args>(args)...);
+    log<LogLevel::info>(category, fmt, std::forward<Args>(args)...);
   }
 
   template<typename... Args>
   inline void info(format_string_t<Args...> fmt, Args&&... args)
   {
-    log(CATEGORY_NONE, LogLevel::info, fmt, std::forward<Args>(args)...);
+    log<LogLevel::info>(CATEGORY_NONE, fmt, std::forward<Args>(args)...);
   }
 
   template<typename T>
   void info(const CategoryKeyT category, const T& msg)
   {
-    log(category, LogLevel::info, "{}", msg);
+    log<LogLevel::info>(category, "{}", msg);
   }
 
   template<typename T>
   void info(const T& msg)
   {
-    log(CATEGORY_NONE, LogLevel::info, "{}", msg);
+    log<LogLevel::info>(CATEGORY_NONE, "{}", msg);
   }
 
   template<typename... Args>
   inline void warning(const CategoryKeyT category, format_string_t<Args...> fmt, Args&&... args)
   {
-    log(category, LogLevel::warning, fmt, std::forward<Args>(args)...);
+    log<LogLevel::warning>(category, fmt, std::forward<Args>(args)...);
   }
 
   template<typename... Args>
   inline void warning(format_string_t<Args...> fmt, Args&&... args)
   {
-    log(CATEGORY_NONE, LogLevel::warning, fmt, std::forward<Args>(args)...);
+    log<LogLevel::warning>(CATEGORY_NONE, fmt, std::forward<Args>(args)...);
   }
 
   template<typename T>
   void warning(const CategoryKeyT category, const T& msg)
   {
-    log(category, LogLevel::warning, "{}", msg);
+    log<LogLevel::warning>(category, "{}", msg);
   }
 
   template<typename T>
   void warning(const T& msg)
   {
-    log(CATEGORY_NONE, LogLevel::warning, "{}", msg);
+    log<LogLevel::warning>(CATEGORY_NONE, "{}", msg);
   }
 
   template<typename... Args>
   inline void error(const CategoryKeyT category, format_string_t<Args...> fmt, Args&&... args)
   {
-    log(category, LogLevel::error, fmt, std::forward<Args>(args)...);
+    log<LogLevel::error>(category, fmt, std::forward<Args>(args)...);
   }
 
   template<typename... Args>
   inline void error(format_string_t<Args...> fmt, Args&&... args)
   {
-    log(CATEGORY_NONE, LogLevel::error, fmt, std::forward<Args>(args)...);
+    log<LogLevel::error>(CATEGORY_NONE, fmt, std::forward<Args>(args)...);
   }
 
   template<typename T>
   void error(const CategoryKeyT category, const T& msg)
   {
-    log(category, LogLevel::error, "{}", msg);
+    log<LogLevel::error>(category, "{}", msg);
   }
 
   template<typename T>
   void error(const T& msg)
   {
-    log(CATEGORY_NONE, LogLevel::error, "{}", msg);
+    log<LogLevel::error>(CATEGORY_NONE, "{}", msg);
   }
 
   template<typename... Args>
   inline void critical(const CategoryKeyT category, format_string_t<Args...> fmt, Args&&... args)
   {
-    log(category, LogLevel::critical, fmt, std::forward<Args>(args)...);
+    log<LogLevel::critical>(category, fmt, std::forward<Args>(args)...);
   }
 
   template<typename... Args>
   inline void critical(format_string_t<Args...> fmt, Args&&... args)
   {
-    log(CATEGORY_NONE, LogLevel::critical, fmt, std::forward<Args>(args)...);
+    log<LogLevel::critical>(CATEGORY_NONE, fmt, std::forward<Args>(args)...);
   }
 
   template<typename T>
   void critical(const CategoryKeyT category, const T& msg)
   {
-    log(category, LogLevel::critical, "{}", msg);
+    log<LogLevel::critical>(category, "{}", msg);
   }
 
   template<typename T>
   void critical(const T& msg)
   {
-    log(CATEGORY_NONE, LogLevel::critical, "{}", msg);
+    log<LogLevel::critical>(CATEGORY_NONE, "{}", msg);
   }
 };
 
@@ -317,18 +612,39 @@ std::shared_ptr<Logger> init_default(LoggerInitParams params);
 /**
  * Set default logger instance
  *
- * Note: this will lead to the destruction of the previous default instance
- * once all users of that logger release their lock on the shared pointer they
- * stored with get(); in the case of a previous init_default() call, that
- * logger instance will only be destructed at program exit
+ * The caller keeps owning `logger`, it stays the default until it is replaced
+ * or destroyed. Note: the previous default instance is kept alive until
+ * program exit, threads may still be using it through a pointer they got from
+ * current() before the replacement
  */
 void set(std::shared_ptr<Logger> logger);
 
 /**
- * Get default logger instance
+ * Get default logger instance, sharing its ownership
+ *
+ * Takes a lock and touches the reference count, use current() for logging.
  *
  * Attention: You must have called init_default() or set() before
  */
 std::shared_ptr<Logger> get();
 
+/// Default logger instance returned by current(), only written by set() and ~Logger()
+extern std::atomic<Logger*> _current;
+
+/**
+ * Get default logger instance without sharing its ownership
+ *
+ * A single atomic load of a pointer which only changes in set(), no lock or
+ * reference count traffic, meant for hot loops. The pointer stays valid while
+ * the instance is the default, and after it was replaced by set().
+ *
+ * Attention: You must have called init_default() or set() before
+ */
+inline Logger* current()
+{
+  auto logger = _current.load(std::memory_order_acquire);
+  assert(logger && "Default logger is not initialized! Did you forget to call init_default()?");
+  return logger;
+}
+
 }  // namespace tedlhy::minekraf::logger
@@ -2,6 +2,14 @@
 
 #include "spdlog/fmt/ostr.h"
 
+/**
+ * Messages below this level are compiled out (set by the
+ * MINEKRAF_LOG_ACTIVE_LEVEL CMake option), one of the LogLevel names.
+ */
+#ifndef MINEKRAF_LOG_ACTIVE_LEVEL
+#define MINEKRAF_LOG_ACTIVE_LEVEL trace
+#endif
+
 namespace tedlhy::minekraf::logger {
 struct LogLevel {
   enum LogLevelEnum {
@@ -45,6 +53,15 @@ bool operator>(LogLevel::LogLevelEnum lhs, const LogLevel& rhs);
 
 std::ostream& operator<<(std::ostream& os, const LogLevel& level);
 
+/// Lowest level which is compiled in, see MINEKRAF_LOG_ACTIVE_LEVEL
+constexpr LogLevel::LogLevelEnum ACTIVE_LEVEL = LogLevel::MINEKRAF_LOG_ACTIVE_LEVEL;
+
+/// True if messages of `level` are compiled in
+constexpr bool level_active(LogLevel::LogLevelEnum level)
+{
+  return level >= ACTIVE_LEVEL;
+}
+
 }  // namespace tedlhy::minekraf::logger
 
 template<>
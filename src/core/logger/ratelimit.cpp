@@ -0,0 +1,63 @@
+#include "ratelimit.h"
+
+#include <algorithm>
+
+using namespace tedlhy::minekraf::logger;
+
+static int64_t _now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+RateLimiter::RateLimiter(RateLimit limit) :
+  interval(0),
+  tolerance(0),
+  sample(1),
+  active(false),
+  full_at(0),
+  seen(0),
+  suppressed(0)
+{
+  set(limit);
+}
+
+void RateLimiter::set(RateLimit limit)
+{
+  auto burst = std::max<uint32_t>(limit.burst, 1);
+  auto _interval = std::chrono::duration_cast<std::chrono::nanoseconds>(limit.period).count() / burst;
+
+  interval.store(_interval, std::memory_order_relaxed);
+  tolerance.store(_interval * (burst - 1), std::memory_order_relaxed);
+  sample.store(std::max<uint32_t>(limit.sample, 1), std::memory_order_relaxed);
+  full_at.store(0, std::memory_order_relaxed);
+  seen.store(0, std::memory_order_relaxed);
+  active.store(_interval > 0 || limit.sample > 1, std::memory_order_relaxed);
+}
+
+bool RateLimiter::admit(uint64_t& dropped)
+{
+  dropped = 0;
+
+  auto _sample = sample.load(std::memory_order_relaxed);
+  if (_sample > 1 && seen.fetch_add(1, std::memory_order_relaxed) % _sample != 0) {
+    return false;
+  }
+
+  auto _interval = interval.load(std::memory_order_relaxed);
+  if (_interval > 0) {
+    auto now = _now();
+    auto _tolerance = tolerance.load(std::memory_order_relaxed);
+    auto _full_at = full_at.load(std::memory_order_relaxed);
+    do {
+      // every message pushes the time the bucket is full again one interval further
+      if (_full_at - now > _tolerance) {
+        suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+    } while (!full_at.compare_exchange_weak(_full_at, std::max(_full_at, now) + _interval, std::memory_order_relaxed));
+  }
+
+  dropped = suppressed.exchange(0, std::memory_order_relaxed);
+  return true;
+}
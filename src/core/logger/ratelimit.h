@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace tedlhy::minekraf::logger {
+
+/**
+ * How many messages a RateLimiter lets through.
+ *
+ * First every `sample`th message is kept, then those are limited to `burst`
+ * messages per `period` (a token bucket refilling evenly over the period, so
+ * a quiet stream can log `burst` messages at once again).
+ */
+struct RateLimit {
+  uint32_t burst = 1;
+  std::chrono::milliseconds period = std::chrono::milliseconds(0);  // 0: no rate limit
+  uint32_t sample = 1;  // 1: no sampling
+};
+
+/**
+ * Lock-free rate limiter for log messages, per category (see
+ * Category::limit) or per call site (see MINEKRAF_LOG_LIMITED()).
+ *
+ * The token bucket is kept as the time the bucket becomes full again
+ * (GCRA), so a message costs a clock read and one compare-exchange; an
+ * unlimited limiter costs one relaxed load (limited()). Messages dropped by
+ * the token bucket are counted and handed to the next message let through,
+ * which logs a "suppressed N messages" summary. Messages dropped by sampling
+ * are expected and not summarized, 1 in N really logs one line in N (Logger
+ * still counts them in LoggerStats::suppressed).
+ */
+class RateLimiter {
+  std::atomic<int64_t> interval;  // ns a token takes to refill, 0: no rate limit
+  std::atomic<int64_t> tolerance;  // ns the bucket can run ahead of now, (burst - 1) * interval
+  std::atomic<uint32_t> sample;
+  std::atomic<bool> active;  // interval or sample set
+
+  std::atomic<int64_t> full_at;  // steady clock ns when the bucket is full again
+  std::atomic<uint64_t> seen;  // messages checked, for sampling
+  std::atomic<uint64_t> suppressed;  // messages dropped by the token bucket since the last one let through
+
+public:
+  explicit RateLimiter(RateLimit limit = {});
+
+  RateLimiter(const RateLimiter&) = delete;
+  RateLimiter& operator=(const RateLimiter&) = delete;
+
+  /// Change the limit, resets the bucket (the suppressed count is kept)
+  void set(RateLimit limit);
+
+  /// False if every message is let through, admit() can be skipped
+  bool limited() const
+  {
+    return active.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Take a token for a message.
+   *
+   * This method returns true if the message should be logged, and sets
+   * `dropped` to the number of messages the token bucket suppressed since the
+   * last one let through (sampling is not included).
+   */
+  bool admit(uint64_t& dropped);
+};
+
+}  // namespace tedlhy::minekraf::logger
@@ -0,0 +1,70 @@
+#include "ringbuffersink.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace tedlhy::minekraf::logger;
+
+RingBufferSink::RingBufferSink(size_t capacity, size_t max_message_size) :
+  entries(std::max<size_t>(capacity, 1)),
+  categories(),
+  category_index(),
+  first(0),
+  next(0),
+  max_message_size(max_message_size)
+{
+  for (auto& entry : entries) {
+    entry.message.reserve(std::min<size_t>(max_message_size, 128));
+  }
+}
+
+void RingBufferSink::sink_it_(const spdlog::details::log_msg& msg)
+{
+  auto name = std::string_view(msg.logger_name.data(), msg.logger_name.size());
+  auto _category = category_index.find(name);
+  if (_category == category_index.end()) {
+    // first message of this logger, there are at most CATEGORY_SLOTS of them
+    _category = category_index.emplace(std::string(name), static_cast<uint16_t>(categories.size())).first;
+    categories.emplace_back(name);
+  }
+
+  auto& entry = entries[next % entries.size()];
+  entry.time = msg.time;
+  entry.thread_id = msg.thread_id;
+  entry.level = msg.level;
+  entry.category = _category->second;
+  entry.message.assign(msg.payload.data(), std::min(msg.payload.size(), max_message_size));
+  next++;
+}
+
+void RingBufferSink::flush_()
+{
+}
+
+void RingBufferSink::clear()
+{
+  const std::lock_guard lock(mutex_);
+  first = next;
+}
+
+uint64_t RingBufferSink::View::begin() const
+{
+  auto capacity = sink.entries.size();
+  return std::max(sink.first, sink.next > capacity ? sink.next - capacity : 0);
+}
+
+uint64_t RingBufferSink::View::end() const
+{
+  return sink.next;
+}
+
+const RingBufferEntry& RingBufferSink::View::at(uint64_t seq) const
+{
+  assert(seq >= begin() && seq < end() && "RingBufferSink entry was overwritten or does not exist yet");
+  return sink.entries[seq % sink.entries.size()];
+}
+
+const std::vector<std::string>& RingBufferSink::View::categories() const
+{
+  return sink.categories;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "spdlog/sinks/base_sink.h"
+
+namespace tedlhy::minekraf::logger {
+
+struct RingBufferEntry {
+  spdlog::log_clock::time_point time;
+  size_t thread_id;
+  spdlog::level::level_enum level;
+  uint16_t category;  // index into RingBufferSink::View::categories()
+  std::string message;  // the formatted message without the pattern, at most max_message_size long
+};
+
+/**
+ * spdlog sink keeping the last `capacity` messages in memory, for viewing
+ * them in-game (see LogConsole).
+ *
+ * Entries are numbered by a sequence number which keeps growing, so readers
+ * can tell which entries they have seen and which have been overwritten
+ * since. Memory is bounded: the entries are allocated up front, messages are
+ * truncated to max_message_size and overwriting an entry reuses its string.
+ */
+class RingBufferSink final : public spdlog::sinks::base_sink<std::mutex> {
+  std::vector<RingBufferEntry> entries;
+  std::vector<std::string> categories;  // logger names in the order they were first seen
+  std::map<std::string, uint16_t, std::less<>> category_index;
+  uint64_t first;  // sequence number of the oldest entry kept by clear()
+  uint64_t next;  // sequence number of the next entry
+  size_t max_message_size;
+
+protected:
+  void sink_it_(const spdlog::details::log_msg& msg) override;
+  void flush_() override;
+
+public:
+  /// Entries of a RingBufferSink, only valid inside RingBufferSink::read()
+  class View {
+    const RingBufferSink& sink;
+
+  public:
+    explicit View(const RingBufferSink& sink) : sink(sink) {}
+
+    /// Sequence number of the oldest buffered entry
+    uint64_t begin() const;
+
+    /// Sequence number after the newest buffered entry
+    uint64_t end() const;
+
+    /// Entry with sequence number seq, which must be in [begin(), end())
+    const RingBufferEntry& at(uint64_t seq) const;
+
+    const std::vector<std::string>& categories() const;
+  };
+
+  explicit RingBufferSink(size_t capacity, size_t max_message_size = 1024);
+
+  /**
+   * Call `fn` with a View of the entries while holding the sink lock,
+   * loggers writing to this sink wait until it returns.
+   *
+   * This method returns what `fn` returns.
+   */
+  template<typename F>
+  decltype(auto) read(F&& fn)
+  {
+    const std::lock_guard lock(mutex_);
+    return std::forward<F>(fn)(View(*this));
+  }
+
+  /// Drop the buffered entries, the categories are kept
+  void clear();
+};
+
+}  // namespace tedlhy::minekraf::logger
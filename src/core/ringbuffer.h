@@ -0,0 +1,221 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace tedlhy::minekraf {
+
+/**
+ * Bounded lock-free multi-producer single-consumer ring buffer.
+ *
+ * Every cell carries a sequence number which tells producers and the consumer
+ * whose turn it is to touch the cell (see Dmitry Vyukov's bounded MPMC queue).
+ * Producers only contend on a single atomic increment, the consumer never
+ * writes a shared counter, and neither side ever takes a lock.
+ *
+ * The capacity is rounded up to the next power of two.
+ */
+template<typename T>
+class MPSCRingBuffer {
+  static constexpr size_t cacheline_size = 64;
+
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  std::unique_ptr<Cell[]> cells;
+  size_t mask;
+
+  alignas(cacheline_size) std::atomic<size_t> tail;  // next position to push, shared by producers
+  alignas(cacheline_size) size_t head;  // next position to pop, owned by the consumer
+
+public:
+  explicit MPSCRingBuffer(size_t capacity) :
+    cells(new Cell[std::bit_ceil(capacity < 2 ? 2 : capacity)]),
+    mask(std::bit_ceil(capacity < 2 ? 2 : capacity) - 1),
+    tail(0),
+    head(0)
+  {
+    for (size_t i = 0; i <= mask; i++) {
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MPSCRingBuffer(const MPSCRingBuffer&) = delete;
+  MPSCRingBuffer& operator=(const MPSCRingBuffer&) = delete;
+
+  /**
+   * Push value into the ring buffer, may be called from any thread.
+   *
+   * `value` is only moved from if the push succeeds.
+   *
+   * This method returns false if the ring buffer is full.
+   */
+  bool try_push(T&& value)
+  {
+    Cell* cell;
+    size_t pos = tail.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &cells[pos & mask];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        // cell is free, try to claim it
+        if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // cell still holds a value from the previous lap
+        return false;
+      } else {
+        // another producer claimed this cell
+        pos = tail.load(std::memory_order_relaxed);
+      }
+    }
+
+    cell->value = std::move(value);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Pop the oldest value from the ring buffer, must only be called from the
+   * consumer thread.
+   *
+   * This method returns false if the ring buffer is empty (or the oldest cell
+   * is still being written by its producer).
+   */
+  bool try_pop(T& value)
+  {
+    Cell* cell = &cells[head & mask];
+    size_t sequence = cell->sequence.load(std::memory_order_acquire);
+    if (static_cast<intptr_t>(sequence) - static_cast<intptr_t>(head + 1) < 0) {
+      return false;
+    }
+
+    value = std::move(cell->value);
+    cell->sequence.store(head + mask + 1, std::memory_order_release);
+    head++;
+    return true;
+  }
+
+  /// Maximum number of values the ring buffer can hold
+  size_t capacity() const
+  {
+    return mask + 1;
+  }
+
+  /// Number of values in the ring buffer, only exact on the consumer thread
+  /// when there are no concurrent producers
+  size_t size_approx() const
+  {
+    return tail.load(std::memory_order_relaxed) - head;
+  }
+};
+
+/**
+ * Bounded wait-free single-producer single-consumer ring buffer.
+ *
+ * Values are written and read in place: the producer reserves the next cell,
+ * fills it and commits it, the consumer reads the oldest cell and pops it
+ * once it is done with it, so nothing is copied in between. Each side caches
+ * the other side's position and only reloads it when the ring looks full (or
+ * empty).
+ *
+ * The capacity is rounded up to the next power of two, cells are default
+ * constructed once and reused.
+ */
+template<typename T>
+class SPSCRingBuffer {
+  static constexpr size_t cacheline_size = 64;
+
+  std::unique_ptr<T[]> cells;
+  size_t mask;
+
+  alignas(cacheline_size) std::atomic<size_t> tail;  // next position to commit, written by the producer
+  size_t head_cache;  // producer's copy of head
+
+  alignas(cacheline_size) std::atomic<size_t> head;  // next position to pop, written by the consumer
+  size_t tail_cache;  // consumer's copy of tail
+
+public:
+  explicit SPSCRingBuffer(size_t capacity) :
+    cells(new T[std::bit_ceil(capacity < 2 ? 2 : capacity)]),
+    mask(std::bit_ceil(capacity < 2 ? 2 : capacity) - 1),
+    tail(0),
+    head_cache(0),
+    head(0),
+    tail_cache(0)
+  {
+  }
+
+  SPSCRingBuffer(const SPSCRingBuffer&) = delete;
+  SPSCRingBuffer& operator=(const SPSCRingBuffer&) = delete;
+
+  /**
+   * Reserve the next cell, must only be called from the producer thread.
+   *
+   * The cell is handed to the consumer by commit(), reserving again without
+   * committing returns the same cell.
+   *
+   * This method returns nullptr if the ring buffer is full.
+   */
+  T* try_reserve()
+  {
+    auto pos = tail.load(std::memory_order_relaxed);
+    if (pos - head_cache > mask) {
+      head_cache = head.load(std::memory_order_acquire);
+      if (pos - head_cache > mask) {
+        return nullptr;
+      }
+    }
+    return &cells[pos & mask];
+  }
+
+  /// Publish the cell returned by try_reserve()
+  void commit()
+  {
+    tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  /**
+   * Get the oldest cell, must only be called from the consumer thread.
+   *
+   * This method returns nullptr if the ring buffer is empty.
+   */
+  T* front()
+  {
+    auto pos = head.load(std::memory_order_relaxed);
+    if (pos == tail_cache) {
+      tail_cache = tail.load(std::memory_order_acquire);
+      if (pos == tail_cache) {
+        return nullptr;
+      }
+    }
+    return &cells[pos & mask];
+  }
+
+  /// Give the cell returned by front() back to the producer
+  void pop()
+  {
+    head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  /// Maximum number of values the ring buffer can hold
+  size_t capacity() const
+  {
+    return mask + 1;
+  }
+
+  /// Number of values in the ring buffer, a lower bound on the consumer thread
+  size_t size_approx() const
+  {
+    return tail.load(std::memory_order_acquire) - head.load(std::memory_order_relaxed);
+  }
+};
+
+}  // namespace tedlhy::minekraf
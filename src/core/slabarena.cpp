@@ -0,0 +1,82 @@
+#include "slabarena.h"
+
+#include <cassert>
+#include <limits>
+
+using namespace tedlhy::minekraf;
+
+SlabArena::SlabArena(size_t slab_size) : slabs(), current(0), _slab_size(slab_size), stats(), mutex()
+{
+}
+
+SlabArena::~SlabArena()
+{
+  assert(stats.live == 0 && "SlabArena destroyed while blocks are still in use");
+}
+
+size_t SlabArena::slab_size() const
+{
+  return _slab_size;
+}
+
+void* SlabArena::allocate(size_t size, SlabIndex& slab)
+{
+  // keep every block aligned
+  size = (size + alignment - 1) & ~(alignment - 1);
+  if (size > _slab_size) {
+    return nullptr;
+  }
+
+  const std::lock_guard lock(mutex);
+
+  if (slabs.empty() || slabs[current].offset + size > _slab_size) {
+    // current slab is full, look for one that has been drained
+    size_t next = slabs.size();
+    for (size_t i = 1; i <= slabs.size(); i++) {
+      size_t candidate = (current + i) % slabs.size();
+      if (slabs[candidate].live == 0) {
+        next = candidate;
+        break;
+      }
+    }
+
+    if (next == slabs.size()) {
+      if (slabs.size() >= std::numeric_limits<SlabIndex>::max()) {
+        return nullptr;
+      }
+      slabs.push_back(Slab{std::make_unique<std::byte[]>(_slab_size)});
+      stats.slab_allocations++;
+      stats.slabs = slabs.size();
+    }
+
+    current = next;
+    slabs[current].offset = 0;
+  }
+
+  auto& _slab = slabs[current];
+  void* block = _slab.memory.get() + _slab.offset;
+  _slab.offset += size;
+  _slab.live++;
+
+  stats.allocations++;
+  stats.live++;
+
+  slab = static_cast<SlabIndex>(current);
+  return block;
+}
+
+void SlabArena::release(SlabIndex slab)
+{
+  const std::lock_guard lock(mutex);
+
+  assert(slab < slabs.size() && slabs[slab].live > 0 && "SlabArena::release() called with invalid slab");
+  slabs[slab].live--;
+  stats.live--;
+}
+
+SlabArenaStats SlabArena::get_stats()
+{
+  const std::lock_guard lock(mutex);
+
+  return stats;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace tedlhy::minekraf {
+
+struct SlabArenaStats {
+  size_t slabs = 0;  // slabs currently owned by the arena
+  size_t slab_allocations = 0;  // heap allocations made for slabs, ever
+  size_t allocations = 0;  // blocks handed out, ever
+  size_t live = 0;  // blocks handed out and not yet released
+};
+
+/**
+ * Bump allocator over a list of recycled fixed-size slabs.
+ *
+ * Blocks are carved from the current slab; a slab is rewound and reused once
+ * every block allocated from it has been released, so a steady stream of
+ * allocate()/release() pairs stops touching the heap after warm-up.
+ *
+ * All methods are thread-safe, the lock is only held for the bump arithmetic.
+ */
+class SlabArena {
+  struct Slab {
+    std::unique_ptr<std::byte[]> memory;
+    size_t offset = 0;
+    size_t live = 0;
+  };
+
+  std::vector<Slab> slabs;
+  size_t current;
+  size_t _slab_size;
+
+  SlabArenaStats stats;
+
+  std::mutex mutex;
+
+public:
+  static constexpr size_t alignment = alignof(std::max_align_t);
+
+  using SlabIndex = uint32_t;
+
+  explicit SlabArena(size_t slab_size);
+  ~SlabArena();
+
+  SlabArena(const SlabArena&) = delete;
+  SlabArena& operator=(const SlabArena&) = delete;
+
+  /// Largest block allocate() can hand out
+  size_t slab_size() const;
+
+  /**
+   * Allocate `size` bytes aligned to `alignment`.
+   *
+   * `slab` receives the index of the slab the block was carved from, pass it
+   * to release() when the block is no longer used.
+   *
+   * This method returns nullptr if `size` is larger than slab_size().
+   */
+  void* allocate(size_t size, SlabIndex& slab);
+
+  /**
+   * Release a block allocated with allocate().
+   *
+   * The slab is recycled once all of its blocks have been released.
+   */
+  void release(SlabIndex slab);
+
+  /// Get allocation counters
+  SlabArenaStats get_stats();
+};
+
+}  // namespace tedlhy::minekraf
@@ -0,0 +1,111 @@
+#include "threadpool.h"
+
+#include <utility>
+
+using namespace tedlhy::minekraf;
+
+ThreadPool::ThreadPool(size_t worker_count) :
+  threads(),
+  mutex(),
+  wake(),
+  done(),
+  job(nullptr),
+  job_context(nullptr),
+  job_size(0),
+  next(0),
+  busy(0),
+  generation(0),
+  stopping(false),
+  error()
+{
+  threads.reserve(worker_count);
+  for (size_t i = 0; i < worker_count; i++) {
+    threads.emplace_back(&ThreadPool::_worker, this);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    const std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+size_t ThreadPool::size() const
+{
+  return threads.size();
+}
+
+void ThreadPool::_worker()
+{
+  uint64_t seen = 0;
+
+  std::unique_lock lock(mutex);
+  for (;;) {
+    wake.wait(lock, [&] { return stopping || generation != seen; });
+    if (stopping) {
+      return;
+    }
+    seen = generation;
+
+    lock.unlock();
+    _work();
+    lock.lock();
+
+    if (--busy == 0) {
+      done.notify_one();
+    }
+  }
+}
+
+void ThreadPool::_work()
+{
+  for (size_t index; (index = next.fetch_add(1, std::memory_order_relaxed)) < job_size;) {
+    try {
+      job(job_context, index);
+    } catch (...) {
+      const std::lock_guard lock(mutex);
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  }
+}
+
+void ThreadPool::_run(size_t count, JobFunc func, void* context)
+{
+  if (threads.empty() || count <= 1) {
+    // not worth waking anyone up
+    for (size_t i = 0; i < count; i++) {
+      func(context, i);
+    }
+    return;
+  }
+
+  {
+    const std::lock_guard lock(mutex);
+    job = func;
+    job_context = context;
+    job_size = count;
+    next.store(0, std::memory_order_relaxed);
+    busy = threads.size();
+    generation++;
+  }
+  wake.notify_all();
+
+  _work();
+
+  std::unique_lock lock(mutex);
+  done.wait(lock, [&] { return busy == 0; });
+
+  if (auto _error = std::exchange(error, nullptr)) {
+    lock.unlock();
+    std::rethrow_exception(_error);
+  }
+}
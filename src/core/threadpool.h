@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace tedlhy::minekraf {
+
+/**
+ * Fixed set of worker threads running fork-join jobs.
+ *
+ * run() hands out the indices of one job to the workers and the calling
+ * thread alike and returns once every index has been processed, so it doubles
+ * as a barrier. Only one job runs at a time; running a job does not allocate.
+ *
+ * A pool without workers runs every job on the calling thread.
+ */
+class ThreadPool {
+  using JobFunc = void (*)(void* context, size_t index);
+
+  std::vector<std::thread> threads;
+
+  std::mutex mutex;
+  std::condition_variable wake;  // workers wait for a new job
+  std::condition_variable done;  // run() waits for the workers to finish the job
+
+  JobFunc job;
+  void* job_context;
+  size_t job_size;
+  std::atomic<size_t> next;  // next index to hand out
+  size_t busy;  // workers which did not finish the current job yet
+  uint64_t generation;  // bumped for every job
+  bool stopping;
+  std::exception_ptr error;  // first exception thrown by the current job
+
+  void _worker();
+
+  /// process indices of the current job until there are none left
+  void _work();
+
+  void _run(size_t count, JobFunc func, void* context);
+
+public:
+  explicit ThreadPool(size_t worker_count);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /// Count of worker threads, not counting the threads calling run()
+  size_t size() const;
+
+  /**
+   * Call `fn(index)` for every index in [0, count) on the workers and the
+   * calling thread, in no particular order.
+   *
+   * Blocks until all calls returned. If any call threw, the first exception
+   * is rethrown once all calls returned.
+   */
+  template<typename F>
+  void run(size_t count, F&& fn)
+  {
+    using Fn = std::remove_reference_t<F>;
+    _run(
+      count, [](void* context, size_t index) { (*static_cast<Fn*>(context))(index); },
+      const_cast<void*>(static_cast<const void*>(&fn)));
+  }
+};
+
+}  // namespace tedlhy::minekraf
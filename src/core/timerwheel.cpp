@@ -0,0 +1,235 @@
+#include "timerwheel.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace tedlhy::minekraf;
+
+static constexpr uint16_t SLOT_NONE = UINT16_MAX;  // timer is not linked into a slot
+
+TimerWheel::TimerWheel() :
+  timers(), free_timers(), slots(), occupied(), expired(), start(Clock::now()), current(0), active_count(0)
+{
+  slots.fill(npos);
+  occupied.fill(0);
+}
+
+uint64_t TimerWheel::_to_ticks(Clock::time_point when) const
+{
+  using namespace std::chrono;
+
+  if (when <= start) {
+    return 0;
+  }
+  // round up, timers must never fire early
+  return static_cast<uint64_t>(ceil<milliseconds>(when - start) / resolution);
+}
+
+void TimerWheel::_link(uint32_t index, uint64_t earliest)
+{
+  constexpr uint64_t span = uint64_t{1} << (slot_bits * level_count);
+
+  auto& timer = timers[index];
+
+  // timers which are already due fire on the earliest tick still collected
+  uint64_t expires = std::max(timer.expires, earliest);
+  uint64_t delta = expires - current;
+
+  size_t level = 0;
+  while (level < level_count - 1 && delta >= (uint64_t{1} << (slot_bits * (level + 1)))) {
+    level++;
+  }
+  if (delta >= span) {
+    // park in the furthest slot, the timer is re-filed once it gets there
+    expires = current + span - 1;
+  }
+
+  size_t slot = level * slot_count + ((expires >> (slot_bits * level)) & (slot_count - 1));
+
+  timer.slot = static_cast<uint16_t>(slot);
+  timer.prev = npos;
+  timer.next = slots[slot];
+  if (timer.next != npos) {
+    timers[timer.next].prev = index;
+  }
+  slots[slot] = index;
+  occupied[level] |= uint64_t{1} << (slot % slot_count);
+}
+
+void TimerWheel::_unlink(uint32_t index)
+{
+  auto& timer = timers[index];
+  if (timer.slot == SLOT_NONE) {
+    return;
+  }
+
+  if (timer.prev != npos) {
+    timers[timer.prev].next = timer.next;
+  } else {
+    slots[timer.slot] = timer.next;
+  }
+  if (timer.next != npos) {
+    timers[timer.next].prev = timer.prev;
+  }
+
+  if (slots[timer.slot] == npos) {
+    occupied[timer.slot / slot_count] &= ~(uint64_t{1} << (timer.slot % slot_count));
+  }
+
+  timer.slot = SLOT_NONE;
+  timer.prev = npos;
+  timer.next = npos;
+}
+
+void TimerWheel::_release(uint32_t index)
+{
+  auto& timer = timers[index];
+  timer.active = false;
+  timer.generation++;
+  timer.payload.clear();
+  free_timers.push_back(index);
+  active_count--;
+}
+
+void TimerWheel::_cascade(size_t level)
+{
+  size_t slot = level * slot_count + ((current >> (slot_bits * level)) & (slot_count - 1));
+
+  // re-file every timer of the slot relative to the current tick, the level 0
+  // slot of the current tick is collected after cascading
+  uint32_t index = slots[slot];
+  while (index != npos) {
+    uint32_t next = timers[index].next;
+    _unlink(index);
+    _link(index, current);
+    index = next;
+  }
+}
+
+void TimerWheel::_collect(Clock::time_point now)
+{
+  using namespace std::chrono;
+
+  // only ticks which fully elapsed are due
+  uint64_t target = now > start ? static_cast<uint64_t>(floor<milliseconds>(now - start) / resolution) : 0;
+
+  while (current < target) {
+    if (active_count == 0) {
+      // nothing to fire or cascade, skip ahead
+      current = target;
+      break;
+    }
+
+    current++;
+
+    // entering the span of a higher level slot, move its timers down
+    for (size_t level = 1; level < level_count; level++) {
+      if (current & ((uint64_t{1} << (slot_bits * level)) - 1)) {
+        break;
+      }
+      _cascade(level);
+    }
+
+    size_t slot = current & (slot_count - 1);
+    if (!(occupied[0] & (uint64_t{1} << slot))) {
+      continue;
+    }
+
+    uint32_t index = slots[slot];
+    while (index != npos) {
+      uint32_t next = timers[index].next;
+      _unlink(index);
+      expired.push_back(index);
+      index = next;
+    }
+  }
+}
+
+void TimerWheel::_finish(uint32_t index)
+{
+  auto& timer = timers[index];
+  if (!timer.active) {
+    // cancelled while being fired
+    _release(index);
+    return;
+  }
+
+  if (!timer.period) {
+    _release(index);
+    return;
+  }
+
+  timer.expires += timer.period;
+  if (timer.expires <= current) {
+    // skip missed periods
+    timer.expires = current + timer.period;
+  }
+  _link(index, current + 1);
+}
+
+TimerID TimerWheel::schedule(uint64_t id, const void* data, size_t data_size, Clock::time_point when,
+  Clock::duration period)
+{
+  using namespace std::chrono;
+
+  uint32_t index;
+  if (!free_timers.empty()) {
+    index = free_timers.back();
+    free_timers.pop_back();
+  } else {
+    index = static_cast<uint32_t>(timers.size());
+    timers.emplace_back();
+  }
+
+  auto& timer = timers[index];
+  timer.id = id;
+  timer.expires = _to_ticks(when);
+  timer.period = period > Clock::duration::zero()
+    ? std::max<uint64_t>(1, static_cast<uint64_t>(ceil<milliseconds>(period) / resolution))
+    : 0;
+  timer.active = true;
+  timer.slot = SLOT_NONE;
+  timer.payload.clear();
+  if (data && data_size) {
+    timer.payload.resize(data_size);
+    std::memcpy(timer.payload.data(), data, data_size);
+  }
+  active_count++;
+
+  _link(index, current + 1);
+
+  return (static_cast<TimerID>(timer.generation) << 32) | (index + 1);
+}
+
+bool TimerWheel::cancel(TimerID id)
+{
+  if (id == TIMER_NONE) {
+    return false;
+  }
+
+  uint32_t index = static_cast<uint32_t>(id & UINT32_MAX) - 1;
+  uint32_t generation = static_cast<uint32_t>(id >> 32);
+  if (index >= timers.size()) {
+    return false;
+  }
+
+  auto& timer = timers[index];
+  if (!timer.active || timer.generation != generation) {
+    return false;
+  }
+
+  if (timer.slot == SLOT_NONE) {
+    // expired and waiting to be fired, _finish() releases it
+    timer.active = false;
+    return true;
+  }
+
+  _unlink(index);
+  _release(index);
+  return true;
+}
+
+size_t TimerWheel::size() const
+{
+  return active_count;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tedlhy::minekraf {
+
+using TimerID = uint64_t;
+
+static constexpr TimerID TIMER_NONE = 0;
+
+/**
+ * Hierarchical timing wheel for delayed and periodic events.
+ *
+ * Time is counted in ticks of `resolution`. Level 0 has one slot per tick for
+ * the next 64 ticks, every further level covers 64 times the span of the
+ * previous one; timers move down a level whenever the wheel passes into the
+ * span of their slot. Scheduling and cancelling are O(1), advancing costs one
+ * bit test per elapsed tick plus the work for timers which are actually due.
+ *
+ * Timers further away than the top level covers are parked in its last slot
+ * and re-filed when they get there.
+ *
+ * TimerWheel is not thread-safe.
+ */
+class TimerWheel {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr auto resolution = std::chrono::milliseconds{1};
+  static constexpr size_t slot_bits = 6;
+  static constexpr size_t slot_count = size_t{1} << slot_bits;
+  static constexpr size_t level_count = 4;
+
+private:
+  static constexpr uint32_t npos = UINT32_MAX;
+
+  struct Timer {
+    uint64_t id = 0;  // EventID of the fired event
+    uint64_t expires = 0;  // in ticks
+    uint64_t period = 0;  // in ticks, 0 for one-shot timers
+    uint32_t prev = npos;
+    uint32_t next = npos;
+    uint32_t generation = 0;
+    uint16_t slot = 0;  // level * slot_count + slot index
+    bool active = false;
+    std::vector<std::byte> payload;  // keeps its capacity when the node is reused
+  };
+
+  std::vector<Timer> timers;
+  std::vector<uint32_t> free_timers;
+  std::array<uint32_t, level_count * slot_count> slots;
+  std::array<uint64_t, level_count> occupied;  // bit per non-empty slot
+  std::vector<uint32_t> expired;
+
+  Clock::time_point start;
+  uint64_t current;  // last processed tick
+  size_t active_count;
+
+  uint64_t _to_ticks(Clock::time_point when) const;
+  void _link(uint32_t index, uint64_t earliest);
+  void _unlink(uint32_t index);
+  void _release(uint32_t index);
+  void _cascade(size_t level);
+  void _collect(Clock::time_point now);
+  void _finish(uint32_t index);
+
+public:
+  TimerWheel();
+
+  /**
+   * Schedule a timer.
+   *
+   * The payload is copied into the timer. Pass `period` > 0 to fire the timer
+   * again every `period` after `when`; missed periods are skipped, not
+   * fired in a burst.
+   *
+   * This method returns the id of the timer.
+   */
+  TimerID schedule(uint64_t id, const void* data, size_t data_size, Clock::time_point when,
+    Clock::duration period = Clock::duration::zero());
+
+  /**
+   * Cancel a timer.
+   *
+   * This method returns true if the timer was pending, false otherwise.
+   */
+  bool cancel(TimerID timer);
+
+  /// Count of pending timers
+  size_t size() const;
+
+  /**
+   * Advance the wheel to `now`, calling `fire(id, data, data_size)` for every
+   * timer which became due, in order of expiry tick.
+   *
+   * This method returns the count of fired timers.
+   */
+  template<typename F>
+  size_t advance(Clock::time_point now, F&& fire)
+  {
+    _collect(now);
+
+    size_t fired = expired.size();
+    for (auto index : expired) {
+      auto& timer = timers[index];
+      fire(timer.id, static_cast<const void*>(timer.payload.data()), timer.payload.size());
+      _finish(index);
+    }
+    expired.clear();
+    return fired;
+  }
+};
+
+}  // namespace tedlhy::minekraf
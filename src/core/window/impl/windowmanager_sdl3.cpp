@@ -5,6 +5,10 @@
 
 #include "SDL3/SDL.h"
 
+#include "imgui.h"
+#include "imgui_impl_opengl3.h"
+#include "imgui_impl_sdl3.h"
+
 #include "core/eventqueue.h"
 
 using namespace tedlhy::minekraf;
@@ -60,6 +64,17 @@ WindowManager::Impl::Impl() : window(nullptr), context(nullptr)
 
 WindowManager::Impl::~Impl()
 {
+  if (ImGui::GetCurrentContext()) {
+    // the renderer backend needs the GL context, either backend may have failed to initialize
+    if (ImGui::GetIO().BackendRendererUserData) {
+      ImGui_ImplOpenGL3_Shutdown();
+    }
+    if (ImGui::GetIO().BackendPlatformUserData) {
+      ImGui_ImplSDL3_Shutdown();
+    }
+    ImGui::DestroyContext();
+  }
+
   if (context) {
     SDL_GL_DestroyContext(context);
     context = nullptr;
@@ -192,6 +207,15 @@ WindowManager::WindowManager(WindowManagerInitParams params) : _impl(new Impl())
     SDL_LogWarn(SDL_LOG_CATEGORY_VIDEO, "Unsupported VSync mode: %s (%s)", static_cast<const char *>(params.vsyncMode),
       SDL_GetError());
   }
+
+  SDL_LogTrace(SDL_LOG_CATEGORY_VIDEO, "Initializing ImGui %s", IMGUI_VERSION);
+  IMGUI_CHECKVERSION();
+  ImGui::CreateContext();
+  ImGui::GetIO().ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
+  if (!ImGui_ImplSDL3_InitForOpenGL(_impl->window, _impl->context) || !ImGui_ImplOpenGL3_Init("#version 130")) {
+    SDL_LogError(SDL_LOG_CATEGORY_VIDEO, "Failed to initialize ImGui backends");
+    throw std::runtime_error("Failed to initialize ImGui backends");
+  }
 }
 
 WindowManager::~WindowManager()
@@ -229,10 +253,16 @@ void WindowManager::preUpdate(float deltatime)
 
 void WindowManager::update(float deltatime)
 {
+  // the frame is open for ImGui windows until postUpdate()
+  ImGui_ImplOpenGL3_NewFrame();
+  ImGui_ImplSDL3_NewFrame();
+  ImGui::NewFrame();
 }
 
 void WindowManager::postUpdate(float deltatime)
 {
+  ImGui::Render();
+  ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
   _impl->swap();
 }
 
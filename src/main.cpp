@@ -1,4 +1,6 @@
+#include <cstdlib>
 #include <iostream>
+#include <string_view>
 
 #include "imgui.h"
 #include "imgui_impl_opengl3.h"
@@ -11,9 +13,41 @@
 
 using namespace tedlhy::minekraf;
 
+static void usage(const char *name)
+{
+  std::cerr << "usage: " << name << " [--record <file>] [--replay <file> [--replay-speed <factor>]]\n"
+            << "  --record <file>          record the events of this session\n"
+            << "  --replay <file>          replay a recorded session instead of live input, then exit\n"
+            << "  --replay-speed <factor>  scale the recorded timing, 0 replays as fast as possible\n";
+}
+
 int main(int argc, char *argv[])
 {
+  const char *record_path = nullptr;
+  const char *replay_path = nullptr;
+  double replay_speed = 1.0;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "--record" && i + 1 < argc) {
+      record_path = argv[++i];
+    } else if (arg == "--replay" && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else if (arg == "--replay-speed" && i + 1 < argc) {
+      replay_speed = std::strtod(argv[++i], nullptr);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
   App &app = App::get();
+  if (record_path && !app.record(record_path)) {
+    return 1;
+  }
+  if (replay_path && !app.replay(replay_path, replay_speed)) {
+    return 1;
+  }
   app.run();
   return 0;
 }
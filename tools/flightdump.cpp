@@ -0,0 +1,45 @@
+/**
+ * Flight recording extractor
+ *
+ * Writes the lines kept in a flight recording (see FlightRecorderSink) as a
+ * text log, oldest first. Works on the recording of a crashed process too.
+ *
+ * usage: minekraf_flightdump <flight recording> [text output]
+ */
+
+#include <fstream>
+#include <iostream>
+
+#include "core/logger/flightrecordersink.h"
+
+using namespace tedlhy::minekraf;
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2 || argc > 3) {
+    std::cerr << "usage: " << argv[0] << " <flight recording> [text output]\n";
+    return 1;
+  }
+
+  std::ifstream in(argv[1], std::ios::binary);
+  if (!in) {
+    std::cerr << argv[0] << ": could not open " << argv[1] << "\n";
+    return 1;
+  }
+
+  std::ofstream file;
+  if (argc == 3) {
+    file.open(argv[2], std::ios::binary);
+    if (!file) {
+      std::cerr << argv[0] << ": could not open " << argv[2] << "\n";
+      return 1;
+    }
+  }
+  std::ostream& out = argc == 3 ? file : std::cout;
+
+  if (!logger::extract_flight_recording(in, out)) {
+    std::cerr << argv[0] << ": " << argv[1] << " is not a flight recording or is truncated\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,45 @@
+/**
+ * Binary log decoder
+ *
+ * Formats a log written with LoggerInitParams::deferred set to
+ * DeferredMode::binary into text, one line per message.
+ *
+ * usage: minekraf_logdecode <binary log> [text output]
+ */
+
+#include <fstream>
+#include <iostream>
+
+#include "core/logger/deferred.h"
+
+using namespace tedlhy::minekraf;
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2 || argc > 3) {
+    std::cerr << "usage: " << argv[0] << " <binary log> [text output]\n";
+    return 1;
+  }
+
+  std::ifstream in(argv[1], std::ios::binary);
+  if (!in) {
+    std::cerr << argv[0] << ": could not open " << argv[1] << "\n";
+    return 1;
+  }
+
+  std::ofstream file;
+  if (argc == 3) {
+    file.open(argv[2]);
+    if (!file) {
+      std::cerr << argv[0] << ": could not open " << argv[2] << "\n";
+      return 1;
+    }
+  }
+  std::ostream& out = argc == 3 ? file : std::cout;
+
+  if (!logger::decode_deferred_log(in, out)) {
+    std::cerr << argv[0] << ": " << argv[1] << " is not a binary log or is truncated\n";
+    return 1;
+  }
+  return 0;
+}